@@ -1,50 +1,79 @@
 /* @brief: HAL.c Hardware Abstraction Layer
  * @author: Yiqing Huang
  * @date: 2014/01/17
- * NOTE: This file contains embedded assembly. 
+ * NOTE: This file contains embedded assembly.
  *       The code borrowed some ideas from ARM RL-RTX source code
+ *       Processes run in thread mode on PSP. The kernel and ISRs run on MSP.
  */
- 
-/* pop off exception stack frame from the stack */
-__asm void __rte(void)
-{
-  PRESERVE8            ; 8 bytes alignement of the stack
-  MVN  LR, #:NOT:0xFFFFFFF9  ; set EXC_RETURN value, Thread mode, MSP
-  BX   LR
-}
 
-/* NOTE: assuming MSP is used. Ideally, PSP should be used */
-__asm void SVC_Handler (void) 
+#include "common.h"
+
+/* Processes make system calls on PSP. rtx_init is called from main() on MSP.
+ * The SVC number indexes g_svc_table. Calls below SVC_NUM_FAST can't block,
+ * so their return value is stored without asking k_svc_return.
+ */
+__asm void SVC_Handler (void)
 {
   PRESERVE8            ; 8 bytes alignement of the stack
-  MRS  R0, MSP         ; Read MSP
-	
-  
+  IMPORT k_svc_return
+  IMPORT g_svc_table
+
+  TST  LR, #4          ; EXC_RETURN bit 2 tells which stack the frame is on
+  ITE  EQ
+  MRSEQ R0, MSP        ; Read MSP
+  MRSNE R0, PSP        ; Read PSP
+
+
   LDR  R1, [R0, #24]   ; Read Saved PC from SP
                        ; Loads R1 from a word 24 bytes above the address in R0
                        ; Note that R0 now contains the the SP value after the
                        ; exception stack frame is pushed onto the stack.
-             
-  LDRH R1, [R1, #-2]   ; Load halfword because SVC number is encoded there
-  BICS R1, R1, #0xFF00 ; Extract SVC Number and save it in R1.  
-                       ; R1 <= R1 & ~(0xFF00), update flags
-                   
-  BNE  SVC_EXIT        ; if SVC Number !=0, exit
- 
-  LDM  R0, {R0-R3, R12}; Read R0-R3, R12 from stack. 
-                       ; NOTE R0 contains the sp before this instruction
-
-  PUSH {R4-R11, LR}    ; Save other registers for preemption caused by i-procs
-  BLX  R12             ; Call SVC C Function, 
-                       ; R12 contains the corresponding 
-                       ; C kernel functions entry point
-                       ; R0-R3 contains the kernel function input parameter (See AAPCS)
-  POP {R4-R11, LR}     ; Restore other registers for preemption caused by i-procs
-  MRS  R12, MSP        ; Read MSP
-  STR  R0, [R12]       ; store C kernel function return value in R0
-                       ; to R0 on the exception stack frame  
-SVC_EXIT  
-	
-  MVN  LR, #:NOT:0xFFFFFFF9  ; set EXC_RETURN value, Thread mode, MSP
+
+  LDRB R1, [R1, #-2]   ; SVC number is the low byte of the SVC instruction
+
+  CMP  R1, #__cpp(SVC_NUM_CALLS)
+  BHS  SVC_EXIT        ; unknown system call, leave R0 as it was
+  LDR  R12, =g_svc_table
+  LDR  R12, [R12, R1, LSL #2] ; R12 = C kernel function entry point
+
+  PUSH {R0, LR}        ; Save the exception stack frame address and EXC_RETURN
+  CMP  R1, #__cpp(SVC_NUM_FAST)
+  LDM  R0, {R0-R3}     ; Read R0-R3 from stack, the kernel function parameters
+                       ; (See AAPCS). LDM leaves the flags from CMP alone.
+  BHS  SVC_SLOW
+
+  BLX  R12             ; Call SVC C Function
+  POP  {R1, LR}
+  STR  R0, [R1]        ; store the return value to R0 on the exception stack frame
+  BX   LR              ; return to the caller's stack
+
+SVC_SLOW
+  BLX  R12             ; Call SVC C Function, which may block
+  LDR  R1, [SP]        ; R1 = exception stack frame
+  BL   k_svc_return    ; store C kernel function return value in R0
+                       ; to R0 on the exception stack frame,
+                       ; or restart the call if the process blocked
+  POP  {R0, LR}
+SVC_EXIT
+
+  BX   LR              ; return to the caller's stack
+}
+
+/* Context switch requested by ISRs and system calls, see k_check_preemption().
+ * PendSV has the lowest priority, so it runs once all other exceptions return.
+ * Only R4-R11 need saving, on top of the exception stack frame on the PSP.
+ */
+__asm void PendSV_Handler (void)
+{
+  PRESERVE8            ; 8 bytes alignement of the stack
+  IMPORT k_pendsv_handler
+
+  MRS   R0, PSP
+  STMDB R0!, {R4-R11}  ; Save other registers on the old process's stack
+  BL    k_pendsv_handler ; R0 = old process's sp, returns the new process's sp
+  LDMIA R0!, {R4-R11}  ; Restore other registers from the new process's stack
+  MSR   PSP, R0
+
+  MVN  LR, #:NOT:0xFFFFFFFD  ; set EXC_RETURN value, Thread mode, PSP
   BX   LR
 }
@@ -1,13 +1,30 @@
 #ifdef k_rtx_init
 
+#undef k_call
+#undef k_cancel_delayed_send
+#undef k_create_process
 #undef k_delayed_send
+#undef k_exit_process
+#undef k_get_cpu_usage
 #undef k_get_process_priority
+#undef k_get_stack_usage
+#undef k_multicast_message
+#undef k_non_blocking_receive_message
 #undef k_receive_message
+#undef k_receive_message_match
+#undef k_receive_messages
+#undef k_receive_message_timeout
+#undef k_periodic_send
 #undef k_release_memory_block
 #undef k_release_processor
+#undef k_reply
 #undef k_request_memory_block
+#undef k_request_memory_block_sized
+#undef k_request_memory_block_timeout
+#undef k_reschedule_delayed_send
 #undef k_rtx_init
 #undef k_send_message
 #undef k_set_process_priority
+#undef k_sleep
 
 #endif
@@ -0,0 +1,155 @@
+#include <assert.h>
+#include <stdbool.h>
+#ifdef BITMAP_QUEUE_TEST
+#include <stdio.h>
+#include <string.h>
+#else
+#include "printf.h"
+#endif
+#include "bitmap_queue.h"
+
+#ifdef __ARMCC_VERSION
+#define bq_clz(x) __clz(x)
+#else
+#define bq_clz(x) __builtin_clz(x)
+#endif
+
+#define LEVEL_BIT(level) (0x80000000u >> (level))
+
+static int to_level(int priority) {
+	assert(BQ_PRIO_BOOST <= priority && priority < NUM_PRIORITIES);
+	return priority - BQ_PRIO_BOOST;
+}
+
+void bq_push_back(bitmap_queue_t *q, pid_t pid, int priority) {
+	const int level = to_level(priority);
+	assert(0 <= pid && pid < NUM_PROCS);
+	assert(!q->level[pid]);
+
+	q->level[pid] = level + 1;
+	q->next[pid] = 0;
+	q->prev[pid] = q->tail[level];
+	if (q->tail[level]) {
+		q->next[q->tail[level] - 1] = pid + 1;
+	} else {
+		q->head[level] = pid + 1;
+		q->bitmap |= LEVEL_BIT(level);
+	}
+	q->tail[level] = pid + 1;
+}
+
+bool bq_remove(bitmap_queue_t *q, pid_t pid) {
+	if (pid < 0 || pid >= NUM_PROCS || !q->level[pid]) {
+		return false;
+	}
+	const int level = q->level[pid] - 1;
+	const int next = q->next[pid], prev = q->prev[pid];
+
+	if (prev) {
+		q->next[prev - 1] = next;
+	} else {
+		q->head[level] = next;
+	}
+	if (next) {
+		q->prev[next - 1] = prev;
+	} else {
+		q->tail[level] = prev;
+	}
+	if (!q->head[level]) {
+		q->bitmap &= ~LEVEL_BIT(level);
+	}
+	q->level[pid] = q->next[pid] = q->prev[pid] = 0;
+	return true;
+}
+
+pid_t bq_peek_front(const bitmap_queue_t *q, int *priority) {
+	if (!q->bitmap) {
+		if (priority) {
+			*priority = NUM_PRIORITIES;
+		}
+		return -1;
+	}
+	const int level = bq_clz(q->bitmap);
+	if (priority) {
+		*priority = level + BQ_PRIO_BOOST;
+	}
+	return q->head[level] - 1;
+}
+
+pid_t bq_pop_front(bitmap_queue_t *q, int *priority) {
+	const pid_t pid = bq_peek_front(q, priority);
+	if (pid != -1) {
+		bq_remove(q, pid);
+	}
+	return pid;
+}
+
+bool bq_contains(const bitmap_queue_t *q, pid_t pid) {
+	return 0 <= pid && pid < NUM_PROCS && q->level[pid];
+}
+
+// Same format as print_priority_queue. Boosted pids are shown as HIGHEST.
+void print_bitmap_queue(const bitmap_queue_t *q) {
+	for (int prio = 0; prio < NULL_PRIO; ++prio) {
+		printf("  Priority %d:", prio);
+		for (int level = to_level(prio == HIGHEST ? BQ_PRIO_BOOST : prio); level <= to_level(prio); ++level) {
+			for (int pid1 = q->head[level]; pid1; pid1 = q->next[pid1 - 1]) {
+				printf(" %d", pid1 - 1);
+			}
+		}
+		printf("\n");
+	}
+}
+
+#ifdef BITMAP_QUEUE_TEST
+// gcc -o bitmap_queue bitmap_queue.c -DBITMAP_QUEUE_TEST -Wall -g3 && ./bitmap_queue
+
+int main(void) {
+	static bitmap_queue_t q;
+	int prio = 0;
+
+	assert(bq_peek_front(&q, &prio) == -1);
+	assert(prio == NUM_PRIORITIES);
+	assert(bq_pop_front(&q, NULL) == -1);
+
+	bq_push_back(&q, 5, LOWEST);
+	bq_push_back(&q, 3, LOWEST);
+	bq_push_back(&q, 0, NULL_PRIO);
+	bq_push_back(&q, 7, MEDIUM);
+	bq_push_back(&q, 12, BQ_PRIO_BOOST);
+	assert(bq_contains(&q, 3) && !bq_contains(&q, 4));
+
+	// Highest priority first, FIFO within a priority
+	assert(bq_pop_front(&q, &prio) == 12 && prio == BQ_PRIO_BOOST);
+	assert(bq_peek_front(&q, &prio) == 7 && prio == MEDIUM);
+	assert(bq_pop_front(&q, NULL) == 7);
+
+	// Remove from the middle, front and back
+	bq_push_back(&q, 9, LOWEST);
+	assert(bq_remove(&q, 3));
+	assert(!bq_remove(&q, 3));
+	assert(bq_pop_front(&q, NULL) == 5);
+	bq_push_back(&q, 3, LOWEST);
+	assert(bq_remove(&q, 3));
+	assert(bq_pop_front(&q, &prio) == 9 && prio == LOWEST);
+	assert(bq_pop_front(&q, &prio) == 0 && prio == NULL_PRIO);
+	assert(bq_pop_front(&q, NULL) == -1);
+	assert(q.bitmap == 0);
+
+	// Every pid fits, in order
+	for (pid_t pid = 0; pid < NUM_PROCS; ++pid) {
+		bq_push_back(&q, pid, pid % NUM_PRIORITIES);
+	}
+	for (int p = 0; p < NUM_PRIORITIES; ++p) {
+		for (pid_t pid = p; pid < NUM_PROCS; pid += NUM_PRIORITIES) {
+			assert(bq_pop_front(&q, &prio) == pid && prio == p);
+		}
+	}
+	assert(bq_peek_front(&q, NULL) == -1);
+
+	static const bitmap_queue_t empty;
+	assert(!memcmp(&q, &empty, sizeof(q)));
+	printf("All passed!\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file:   bitmap_queue.h
+ * @brief:  O(1) priority queue of pids, indexed by a per-priority occupancy bitmap
+ */
+#ifndef BITMAP_QUEUE_H_
+#define BITMAP_QUEUE_H_
+
+#include <stdbool.h>
+#include "common.h"
+#include "k_process.h"
+
+/*
+ * Priority used for processes that must run ahead of everything else at HIGHEST
+ * (KCD and CRT), one level above HIGHEST.
+ */
+#define BQ_PRIO_BOOST (-1)
+
+/* One level per priority, plus the boost level in front */
+#define BQ_NUM_LEVELS (NUM_PRIORITIES + 1)
+
+/*
+ * A FIFO per priority, threaded through per-pid links.
+ * Bit (31 - level) of bitmap is set iff that level is non-empty, so the
+ * highest non-empty level is found with a single CLZ.
+ *
+ * Links and levels are stored off by one, so a zero-initialized queue is empty,
+ * the same as LL_DECLARE.
+ */
+typedef struct bitmap_queue {
+	U32 bitmap;
+	U8 head[BQ_NUM_LEVELS];    /* pid + 1 of the front of each level, or 0 */
+	U8 tail[BQ_NUM_LEVELS];    /* pid + 1 of the back of each level, or 0 */
+	U8 next[NUM_PROCS];        /* pid + 1 of the next pid in the same level, or 0 */
+	U8 prev[NUM_PROCS];        /* pid + 1 of the previous pid in the same level, or 0 */
+	U8 level[NUM_PROCS];       /* level + 1 the pid is queued at, or 0 if not queued */
+} bitmap_queue_t;
+
+// Push pid to the back of its priority's FIFO. pid must not already be queued.
+void bq_push_back(bitmap_queue_t *q, pid_t pid, int priority);
+
+// Pop the front of the highest non-empty priority, or -1 if empty.
+// If priority is not NULL, it gets the priority the pid was queued at.
+pid_t bq_pop_front(bitmap_queue_t *q, int *priority);
+
+// Same as bq_pop_front, without popping.
+// *priority is NUM_PRIORITIES if the queue is empty.
+pid_t bq_peek_front(const bitmap_queue_t *q, int *priority);
+
+// Remove pid from wherever it is queued. Returns false if it wasn't queued.
+bool bq_remove(bitmap_queue_t *q, pid_t pid);
+
+bool bq_contains(const bitmap_queue_t *q, pid_t pid);
+
+void print_bitmap_queue(const bitmap_queue_t *q);
+
+#endif /* ! BITMAP_QUEUE_H_ */
@@ -5,12 +5,30 @@
  */
 
 #ifndef COMMON_H_
-#define COMMON_H_
-
+#define COMMON_H_
+
 #define LOW_MEM
 
 #define K_MSG_ENV
 
+/* Record kernel events in a ring buffer, see k_trace.h */
+#define K_TRACE
+
+/* Carve the memory pools out of the AHB SRAM, so most message copies don't
+   contend with stack traffic on the same bus. The local SRAM left above the
+   image still holds more default blocks, used once those run out. */
+#define HEAP_IN_AHB_SRAM
+
+/* Make the bottom of the running process's stack no-access with the MPU,
+   so an overflow traps into MemManage_Handler */
+#define MPU_STACK_GUARD
+
+/* Program TIMER0 for the next deadline instead of interrupting every 1 ms.
+   Timeslicing needs the periodic interrupt. */
+#ifndef HAS_TIMESLICING
+#define HAS_TICKLESS_IDLE
+#endif
+
 /* Definitions */
 
 #define BOOL unsigned char
@@ -41,7 +59,14 @@
 #define PID_CRT          13
 #define PID_TIMER_IPROC  14
 #define PID_UART_IPROC   15
-#define MAX_PID 15
+#define PID_TOP          16
+#define MAX_PID 16
+/* pids above MAX_PID are handed out by create_process */
+#define NUM_DYNAMIC_PROCS 4
+#define NUM_PROCS (MAX_PID + 1 + NUM_DYNAMIC_PROCS)
+
+/* The core clock k_cycle_count.h sets up, which get_cpu_usage counts cycles of */
+#define CORE_CLK_HZ 100000000UL
 
 
 /* Process Priority. The bigger the number is, the lower the priority is*/
@@ -57,20 +82,62 @@
 /* Defining the Hot Keys for debug information */
 
 #define HOTKEY_READY_QUEUE '!'
-#define HOTKEY_BLOCKED_MEM_QUEUE '@'
+#define HOTKEY_BLOCKED_MEM_QUEUE '@'
 #define HOTKEY_BLOCKED_MSG_QUEUE '#'
+/* Which processes hold each memory block in use, to find leaks */
+#define HOTKEY_MEMORY_BLOCKS '^'
+/* Each process's stack high-water mark, see get_stack_usage */
+#define HOTKEY_STACK_USAGE '&'
+/* Dumps the kernel trace to UART1, when K_TRACE is defined */
+#define HOTKEY_TRACE_DUMP '$'
 
 
 /* Message Types */
 #define DEFAULT 0
 #define KCD_REG 1
 #define KCD_KEYBOARD_INPUT 2
-#define CRT_DISPLAY 3
-#define COUNT_REPORT 4
+#define CRT_DISPLAY 3
+#define COUNT_REPORT 4
 #define WAKEUP_10 5
 
+/* Filters for receive_message_match */
+#define MTYPE_ANY (-1)
+#define PID_BIT(pid) (1u << (pid))
+#define PID_ANY 0xFFFFFFFFu
+
 #define NO_CHAR (-1)
 
+/* System call numbers, the immediate of the SVC instruction. See g_svc_table.
+   Calls below SVC_NUM_FAST never block, so they are never restarted. */
+#define SVC_GET_PROCESS_PRIORITY 0
+#define SVC_SET_PROCESS_PRIORITY 1
+#define SVC_RELEASE_PROCESSOR    2
+#define SVC_RELEASE_MEMORY_BLOCK 3
+#define SVC_SEND_MESSAGE         4
+#define SVC_DELAYED_SEND         5
+#define SVC_CANCEL_DELAYED_SEND  6
+#define SVC_RESCHEDULE_DELAYED_SEND 7
+#define SVC_PERIODIC_SEND        8
+#define SVC_CREATE_PROCESS       9
+#define SVC_EXIT_PROCESS         10
+#define SVC_GET_CPU_USAGE        11
+#define SVC_RTX_INIT             12
+#define SVC_NON_BLOCKING_RECEIVE_MESSAGE 13
+#define SVC_REPLY                14
+#define SVC_MULTICAST_MESSAGE    15
+#define SVC_GET_STACK_USAGE      16
+#define SVC_NUM_FAST             17
+#define SVC_REQUEST_MEMORY_BLOCK 17
+#define SVC_RECEIVE_MESSAGE      18
+#define SVC_SLEEP                19
+#define SVC_REQUEST_MEMORY_BLOCK_TIMEOUT 20
+#define SVC_RECEIVE_MESSAGE_TIMEOUT 21
+#define SVC_RECEIVE_MESSAGE_MATCH 22
+#define SVC_RECEIVE_MESSAGES     23
+#define SVC_CALL                 24
+#define SVC_REQUEST_MEMORY_BLOCK_SIZED 25
+#define SVC_NUM_CALLS            26
+
 /* ----- Types ----- */
 typedef unsigned char U8;
 typedef unsigned int U32;
@@ -86,6 +153,19 @@ typedef struct proc_init
 	void (*mpf_start_pc) ();/* entry point of the process */    
 } PROC_INIT;
 
+/* process states */
+/* UNUSED: the pid is free for create_process, or its process exited */
+typedef enum {NEW = 0, RDY, RUN, BLOCKED_ON_RESOURCE, BLOCKED_ON_RECEIVE, BLOCKED_ON_TIMER, BLOCKED_ON_REPLY, UNUSED, NUM_PROC_STATES} PROC_STATE_E;
+
+/* CPU accounting of a process, filled in by get_cpu_usage */
+typedef struct proc_cpu
+{
+	U32 m_cycles;           /* core clock cycles spent running, wraps around */
+	U32 m_switches;         /* number of times it was switched to */
+	int m_state;            /* current state, a PROC_STATE_E */
+	int m_priority;         /* current priority */
+} PROC_CPU;
+
 /* message buffer */
 typedef struct msgbuf
 {
@@ -100,12 +180,20 @@ typedef struct msgbuf
 } MSG_BUF;
 
 #define MEM_BLOCK_SIZE 128
-#define MTEXT_MAXLEN (MEM_BLOCK_SIZE - offsetof(struct msgbuf, mtext) - 1)
+#define MEM_BLOCK_SIZE_SMALL 64
+#define MEM_BLOCK_SIZE_LARGE 512
+/* The longest string that fits in a message of a block of the given size */
+#define MTEXT_MAXLEN_OF(size) ((size) - offsetof(struct msgbuf, mtext) - 1)
+#define MTEXT_MAXLEN MTEXT_MAXLEN_OF(MEM_BLOCK_SIZE)
 
+/* Only the process itself runs on its stack. The kernel and ISRs run on MSP. */
 #ifdef DEBUG_0
 #define USR_SZ_STACK 0x200         /* user proc stack size 512B   */
 #else
-#define USR_SZ_STACK 0x100         /* user proc stack size 218B  */
+#define USR_SZ_STACK 0x180         /* user proc stack size 384B  */
 #endif /* DEBUG_0 */
+/* The smallest stack create_process takes: the initial context, the guard
+   at the bottom, and a little room to make system calls */
+#define MIN_SZ_STACK 0x80
 
 #endif // COMMON_H_
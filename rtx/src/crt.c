@@ -1,4 +1,4 @@
-#include <assert.h>
+#include <assert.h>
 #include "uart.h"
 #include "crt.h"
 #include "message_queue.h"
@@ -6,39 +6,47 @@
 MSG_BUF *output = NULL;
 int offset = 0;
 
+// Most messages one receive_messages call takes
+#define CRT_BATCH 8
+
+static void crt_accept(MSG_BUF *msg, int from) {
+	if (msg->mtype == CRT_DISPLAY) {
+		msg->m_kdata[0] = 0;
+		enqueue_message(msg, &output);
+		// We're unblocked.
+	} else if (from == PID_UART_IPROC) {
+		disable_irq();
+		*(volatile char *)msg->mtext = 0;
+		enable_irq();
+		// We're unblocked.
+	} else {
+		assert(0);
+		release_memory_block(msg);
+	}
+}
+
 void proc_crt(void) {
 	for (;;) {
-		int from = -1;
-		MSG_BUF* msg = receive_message(&from);
-		if (msg == NULL) {
-			assert(0);
-			continue;
-		} else if (msg->mtype == CRT_DISPLAY) {
-			msg->m_kdata[0] = 0;
-			enqueue_message(msg, &output);
-			// We're unblocked.
-		} else if (from == PID_UART_IPROC) {
-			disable_irq();
-			*(volatile char *)msg->mtext = 0;
-			enable_irq();
-			// We're unblocked.
-		} else {
-			assert(0);
-			release_memory_block(msg);
-			continue;
+		MSG_BUF *msgs[CRT_BATCH];
+		int froms[CRT_BATCH];
+		// A burst of output takes one system call rather than one per message
+		const int n = receive_messages((void **)msgs, froms, CRT_BATCH);
+		assert(n > 0);
+		for (int i = 0; i < n; ++i) {
+			crt_accept(msgs[i], froms[i]);
 		}
 
 		// Block ourselves
 		while (!is_queue_empty(&output)) {
 			// Check if we have a character to print.
 			// Allow printing the last character, if it's not '\0'
-			if (offset <= MTEXT_MAXLEN && output->mtext[offset] != '\0') {
-				// Try to print the next character
-				if (!uart_iproc_putc(output->mtext[offset])) {
-					// Blocked!
-					break;
-				}
-				++offset;
+			if (offset <= MTEXT_MAXLEN && output->mtext[offset] != '\0') {
+				// Try to print the next character
+				if (!uart_iproc_putc(output->mtext[offset])) {
+					// Blocked!
+					break;
+				}
+				++offset;
 			} else {
 				MSG_BUF *empty = output;
 				output = output->mp_next;
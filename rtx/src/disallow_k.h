@@ -1,13 +1,30 @@
 #ifndef k_rtx_init
 
+#define k_call ((void *)k_call)
+#define k_cancel_delayed_send ((void *)k_cancel_delayed_send)
+#define k_create_process ((void *)k_create_process)
 #define k_delayed_send ((void *)k_delayed_send)
+#define k_exit_process ((void *)k_exit_process)
+#define k_get_cpu_usage ((void *)k_get_cpu_usage)
 #define k_get_process_priority ((void *)k_get_process_priority)
+#define k_get_stack_usage ((void *)k_get_stack_usage)
+#define k_multicast_message ((void *)k_multicast_message)
+#define k_non_blocking_receive_message ((void *)k_non_blocking_receive_message)
 #define k_receive_message ((void *)k_receive_message)
+#define k_receive_message_match ((void *)k_receive_message_match)
+#define k_receive_messages ((void *)k_receive_messages)
+#define k_receive_message_timeout ((void *)k_receive_message_timeout)
+#define k_periodic_send ((void *)k_periodic_send)
 #define k_release_memory_block ((void *)k_release_memory_block)
 #define k_release_processor ((void *)k_release_processor)
+#define k_reply ((void *)k_reply)
 #define k_request_memory_block ((void *)k_request_memory_block)
+#define k_request_memory_block_sized ((void *)k_request_memory_block_sized)
+#define k_request_memory_block_timeout ((void *)k_request_memory_block_timeout)
+#define k_reschedule_delayed_send ((void *)k_reschedule_delayed_send)
 #define k_rtx_init ((void *)k_rtx_init)
 #define k_send_message ((void *)k_send_message)
 #define k_set_process_priority ((void *)k_set_process_priority)
+#define k_sleep ((void *)k_sleep)
 
 #endif
@@ -6,151 +6,629 @@
  */
 
 #include "k_memory.h"
- #include "k_process.h"
-#include "priority_queue.h"
+ #include "k_process.h"
+#include "priority_queue.h"
+#include "k_trace.h"
+#include "uart_polling.h"
 #include <assert.h>
+#include <string.h>
 
-#ifdef DEBUG_0
+#if defined(DEBUG_0) || defined(_DEBUG_HOTKEYS)
 #include "printf.h"
 #endif /* ! DEBUG_0 */
 
 #include "allow_k.h"
 
 /* ----- Global Variables ----- */
-U32 *gp_stack; /* The last allocated stack low address. 8 bytes aligned */
-               /* The first stack starts at the RAM high address */
-	       /* stack grows down. Fully decremental stack */
 
-mem_t mem_blocks[NUM_MEM_BLOCKS];
-LL_DECLARE(g_heap, mem_t*, NUM_MEM_BLOCKS);
 U8 *gp_heap_begin_addr;
 U8 *gp_heap_end_addr;
+#ifdef HEAP_IN_AHB_SRAM
+static U8 *gp_ahb_heap_end_addr; /* the heap in the AHB SRAM starts at AHB_SRAM_BEGIN_ADDR */
+#endif
+
+/* A size class. Its free blocks are a FIFO, linked through their first word. */
+typedef struct mem_pool {
+	U8 *mp_blocks;          /* block 0, the others follow */
+	U32 m_block_size;
+	int m_num_blocks;
+	int m_first;            /* index of block 0 in g_mem_holders and g_mem_used */
+	void *mp_free_front;
+	void *mp_free_back;
+	int m_num_free;
+} mem_pool_t;
+
+/* By MEM_POOL_*, smallest first. memory_init carves them out of the RAM
+   above the image, and the default pool gets whatever the others leave.
+   With HEAP_IN_AHB_SRAM, that's the AHB SRAM, and MEM_POOL_DEFAULT_LOCAL
+   gets the RAM above the image. */
+static mem_pool_t g_mem_pools[NUM_MEM_POOLS] = {
+	[MEM_POOL_SMALL]   = {NULL, MEM_BLOCK_SIZE_SMALL, NUM_SMALL_MEM_BLOCKS},
+	[MEM_POOL_DEFAULT] = {NULL, MEM_BLOCK_SIZE,       0},
+#ifdef HEAP_IN_AHB_SRAM
+	[MEM_POOL_DEFAULT_LOCAL] = {NULL, MEM_BLOCK_SIZE, 0},
+#endif
+	[MEM_POOL_LARGE]   = {NULL, MEM_BLOCK_SIZE_LARGE, NUM_LARGE_MEM_BLOCKS},
+};
+
+/* The number of blocks in all the pools */
+static int g_num_mem_blocks = 0;
+
+/* PID_BIT of each process holding a reference to the block, so exit_process
+   can reclaim it. A process holds at most one, so this is the reference count.
+   Sending a block hands the sender's reference to the receiver, and
+   multicast_message gives each receiver one. */
+#define NO_OWNER (-1)
+static U32 *g_mem_holders;
+
+/* Bit i % 32 of word i / 32 is set while block i is out of the heap,
+   so releasing it twice is caught without searching the heap */
+static U32 *g_mem_used;
+#define MEM_USED_WORD(i) g_mem_used[(i) / 32]
+#define MEM_USED_BIT(i) (1u << ((i) % 32))
+
+/* The same bit of g_mem_queued is set while block i is linked into a mailbox
+   through its own mp_next, which can only be in one list at a time */
+static U32 *g_mem_queued;
+#define MEM_QUEUED_WORD(i) g_mem_queued[(i) / 32]
+
+static void k_memory_push_free(mem_pool_t *p_pool, void *p_mem_blk)
+{
+	*(void **)p_mem_blk = NULL;
+	if (p_pool->mp_free_back != NULL) {
+		*(void **)p_pool->mp_free_back = p_mem_blk;
+	} else {
+		p_pool->mp_free_front = p_mem_blk;
+	}
+	p_pool->mp_free_back = p_mem_blk;
+	++p_pool->m_num_free;
+}
+
+// Lay out p_pool's blocks from p_end, all free. Pools are carved in MEM_POOL_* order.
+static U8 *k_memory_carve(mem_pool_t *p_pool, U8 *p_end)
+{
+	p_pool->mp_blocks = p_end;
+	p_pool->m_first = g_num_mem_blocks;
+	p_pool->mp_free_front = p_pool->mp_free_back = NULL;
+	p_pool->m_num_free = 0;
+	for (int i = 0; i < p_pool->m_num_blocks; i++) {
+		k_memory_push_free(p_pool, p_end);
+		p_end += p_pool->m_block_size;
+	}
+	g_num_mem_blocks += p_pool->m_num_blocks;
+	return p_end;
+}
+
+static void *k_memory_pop_free(mem_pool_t *p_pool)
+{
+	void *const p_mem_blk = p_pool->mp_free_front;
+	assert(p_mem_blk != NULL);
+	p_pool->mp_free_front = *(void **)p_mem_blk;
+	if (p_pool->mp_free_front == NULL) {
+		p_pool->mp_free_back = NULL;
+	}
+	--p_pool->m_num_free;
+	return p_mem_blk;
+}
 
 /**
  * @brief: Initialize RAM as follows:
 
 0x10008000+---------------------------+ High Address
-          |    Proc 1 STACK           |
-          |---------------------------|
-          |    Proc 2 STACK           |
-          |---------------------------|<--- gp_stack
-          |                           |
-          |        HEAP               |
-          |                           |
-          |---------------------------|
-          |        PCB 2              |
-          |---------------------------|
-          |        PCB 1              |
+          |  leftover, under a block  |
+          |---------------------------|<--- gp_heap_end_addr
+          |  g_mem_holders, g_mem_used|
+          |  g_mem_queued             |
           |---------------------------|
+          |  HEAP: the pools, small,  |
+          |  default, then large      |
+          |---------------------------|<--- gp_heap_begin_addr
           |        Padding            |
           |---------------------------|
           |Image$$RW_IRAM1$$ZI$$Limit |
           |...........................|
           |       RTX  Image          |
-          |                           |
+          | (stack_space, g_stack_pool|
+          |  hold the process stacks) |
 0x10000000+---------------------------+ Low Address
 
+ * With HEAP_IN_AHB_SRAM, the small, default and large pools fill the AHB SRAM
+ * from AHB_SRAM_BEGIN_ADDR to AHB_SRAM_END_ADDR instead, and the HEAP above
+ * the image is MEM_POOL_DEFAULT_LOCAL. The arrays for all of them stay here.
 */
 
 void memory_init(void)
 {
 	U8 *p_end = (U8 *)&Image$$RW_IRAM1$$ZI$$Limit;
-	int i;
 
 	/* 4 bytes padding */
 	p_end += 4;
 
-	/* prepare for alloc_stack() to allocate memory for stacks */
-	gp_stack = (U32 *)RAM_END_ADDR;
-	if ((U32)gp_stack & 0x04) { /* 8 bytes alignment */
-		--gp_stack;
+	/* allocate memory for heap, 8 bytes aligned */
+	p_end = (U8 *)(((U32)p_end + 7) & ~7u);
+	gp_heap_begin_addr = p_end;
+
+	// Each block also takes a holder mask and a bit of g_mem_used and g_mem_queued,
+	// a byte at most, plus a word each for rounding them up
+	U32 fixed_b = 2 * sizeof(U32);
+	g_num_mem_blocks = 0;
+#ifdef HEAP_IN_AHB_SRAM
+	// The default pool gets what the small and large ones leave of the AHB SRAM
+	U32 ahb_fixed_b = 0;
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		ahb_fixed_b += g_mem_pools[pool].m_num_blocks * g_mem_pools[pool].m_block_size;
+		fixed_b += g_mem_pools[pool].m_num_blocks * (sizeof(U32) + 1);
 	}
+	assert(ahb_fixed_b <= AHB_SRAM_END_ADDR - AHB_SRAM_BEGIN_ADDR);
+	g_mem_pools[MEM_POOL_DEFAULT].m_num_blocks =
+		(AHB_SRAM_END_ADDR - AHB_SRAM_BEGIN_ADDR - ahb_fixed_b) / MEM_BLOCK_SIZE;
+	fixed_b += g_mem_pools[MEM_POOL_DEFAULT].m_num_blocks * (sizeof(U32) + 1);
+	assert(p_end + fixed_b <= (U8 *)RAM_END_ADDR);
+	g_mem_pools[MEM_POOL_DEFAULT_LOCAL].m_num_blocks =
+		(RAM_END_ADDR - (U32)p_end - fixed_b) / (MEM_BLOCK_SIZE + sizeof(U32) + 1);
 
-	/* allocate memory for heap*/
-	gp_heap_begin_addr = p_end;
+	U8 *p_ahb = (U8 *)AHB_SRAM_BEGIN_ADDR;
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		if (pool == MEM_POOL_DEFAULT_LOCAL) {
+			p_end = k_memory_carve(&g_mem_pools[pool], p_end);
+		} else {
+			p_ahb = k_memory_carve(&g_mem_pools[pool], p_ahb);
+		}
+	}
+	gp_ahb_heap_end_addr = p_ahb;
+	assert(gp_ahb_heap_end_addr <= (U8 *)AHB_SRAM_END_ADDR);
+#else
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		fixed_b += g_mem_pools[pool].m_num_blocks * (g_mem_pools[pool].m_block_size + sizeof(U32) + 1);
+	}
+	assert(p_end + fixed_b <= (U8 *)RAM_END_ADDR);
+	g_mem_pools[MEM_POOL_DEFAULT].m_num_blocks =
+		(RAM_END_ADDR - (U32)p_end - fixed_b) / (MEM_BLOCK_SIZE + sizeof(U32) + 1);
 
-  	for( i = 0; i < NUM_MEM_BLOCKS; i++) {
-	    LL_PUSH_FRONT_(g_heap) = &mem_blocks[i];
-	    p_end += MEM_BLOCK_SIZE;
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		p_end = k_memory_carve(&g_mem_pools[pool], p_end);
 	}
+#endif
+
+	g_mem_holders = (U32 *)p_end;
+	p_end += g_num_mem_blocks * sizeof(U32);
+	g_mem_used = (U32 *)p_end;
+	p_end += (g_num_mem_blocks + 31) / 32 * sizeof(U32);
+	g_mem_queued = (U32 *)p_end;
+	p_end += (g_num_mem_blocks + 31) / 32 * sizeof(U32);
+	memset(g_mem_holders, 0, p_end - (U8 *)g_mem_holders);
 
 	gp_heap_end_addr = p_end;
-}
-
-static char __attribute__((aligned(8))) stack_space[13 * 0x200 + 8];
-static int stack_space_begin = 0;
+	assert(gp_heap_end_addr <= (U8 *)RAM_END_ADDR);
+}
+
+static void paint_stack(U32 *p_limit, U32 *sp)
+{
+	while (p_limit != sp) {
+		*p_limit++ = STACK_PAINT;
+	}
+}
+
+/* Room for the system processes in g_proc_table and the test processes. Each stack
+   is rounded up to 8 bytes and starts STACK_GUARD_SIZE aligned, which wastes at most
+   STACK_GUARD_SIZE - 8 bytes below it, and alloc_stack keeps 8 bytes past the last. */
+#define NUM_STACK_SPACE_PROCS (NUM_SYS_SZ_STACK + 1 + NUM_TEST_PROCS)
+#define STACK_SPACE_SIZE (NUM_SYS_SZ_STACK * SYS_SZ_STACK + TOP_SZ_STACK + NUM_TEST_PROCS * USR_SZ_STACK \
+	+ NUM_STACK_SPACE_PROCS * (STACK_GUARD_SIZE - 8) + 8)
+static char __attribute__((aligned(STACK_GUARD_SIZE))) stack_space[STACK_SPACE_SIZE];
+static int stack_space_begin = 0;
 
 /**
  * @brief: allocate stack for a process, align to 8 bytes boundary
  * @param: size, stack size in bytes
  * @return: The top of the stack (i.e. high address)
- * POST:  gp_stack is updated.
  */
 
 U32 *alloc_stack(U32 size_b)
-{
-	stack_space_begin += size_b;
-	stack_space_begin = (stack_space_begin + 7) / 8 * 8;
+{
+	stack_space_begin = (stack_space_begin + STACK_GUARD_SIZE - 1) / STACK_GUARD_SIZE * STACK_GUARD_SIZE;
+	U32 *const p_limit = (U32 *)(stack_space + stack_space_begin);
+	stack_space_begin += size_b;
+	stack_space_begin = (stack_space_begin + 7) / 8 * 8;
 	assert(stack_space_begin + 8 <= sizeof(stack_space));
-	return (U32 *)(stack_space + stack_space_begin);
+	U32 *const sp = (U32 *)(stack_space + stack_space_begin);
+	paint_stack(p_limit, sp);
+	return sp;
 }
 
-void *k_request_memory_block(void)
+/* Stacks for processes made by create_process, reused once they exit */
+static U32 __attribute__((aligned(STACK_GUARD_SIZE))) g_stack_pool[NUM_DYNAMIC_PROCS][USR_SZ_STACK / 4];
+static U32 g_stack_pool_used = 0; /* bit i is set while g_stack_pool[i] is taken */
+
+/**
+ * @brief: take a stack from the stack pool
+ * @param: size, stack size in bytes, at most USR_SZ_STACK
+ * @return: The top of the stack (i.e. high address), or NULL if none is free
+ */
+U32 *alloc_pool_stack(U32 size_b)
 {
-	U8 *p_mem_blk = NULL;
+	if (size_b > sizeof(g_stack_pool[0])) {
+		return NULL;
+	}
+	for (int i = 0; i < NUM_DYNAMIC_PROCS; ++i) {
+		if (!(g_stack_pool_used & (1u << i))) {
+			g_stack_pool_used |= 1u << i;
+			// It may hold what the last process that had it left
+			paint_stack(g_stack_pool[i], g_stack_pool[i] + USR_SZ_STACK / 4);
+			return g_stack_pool[i] + USR_SZ_STACK / 4;
+		}
+	}
+	return NULL;
+}
 
-	while(LL_SIZE(g_heap) == 0) {
-        // release proc, put cur proc. in ready queue
-        // not right because: call k
-        // never set current state to blocked
-        // if all we do is release processor
-        k_poll(BLOCKED_ON_RESOURCE);
+/**
+ * @brief: give a stack back to the stack pool
+ * @param: sp, any address in the stack. Stacks from alloc_stack are ignored.
+ */
+void free_pool_stack(U32 *sp)
+{
+	const unsigned long offset = (unsigned long)sp - (unsigned long)g_stack_pool;
+	if (offset <= sizeof(g_stack_pool) && offset > 0) {
+		// sp may be the top of the stack, which is the end of its slot
+		g_stack_pool_used &= ~(1u << ((offset - 1) / sizeof(g_stack_pool[0])));
+	}
+}
+
+/**
+ * @brief: the pool p_mem_blk is from, and its index across all pools
+ * @return: -1 if it isn't the start of a block
+ */
+static int k_memory_block_pool(void *p_mem_blk, int *p_index)
+{
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		const mem_pool_t *const p_pool = &g_mem_pools[pool];
+		const unsigned long offset = (unsigned long)p_mem_blk - (unsigned long)p_pool->mp_blocks;
+		if (offset < p_pool->m_num_blocks * p_pool->m_block_size) {
+			if (offset % p_pool->m_block_size != 0) {
+				return -1;
+			}
+			*p_index = p_pool->m_first + offset / p_pool->m_block_size;
+			return pool;
+		}
+	}
+	return -1;
+}
+
+static int k_memory_block_index(void *p_mem_blk)
+{
+	int i = -1;
+	k_memory_block_pool(p_mem_blk, &i);
+	return i;
+}
+
+// The block with index i across all pools
+static U8 *k_memory_block_at(int i)
+{
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		const mem_pool_t *const p_pool = &g_mem_pools[pool];
+		if (i < p_pool->m_first + p_pool->m_num_blocks) {
+			return p_pool->mp_blocks + (i - p_pool->m_first) * p_pool->m_block_size;
+		}
 	}
-	//increment the address the address of the node by the header size to get the start address of the block itslef 
-	p_mem_blk = (U8 *)LL_POP_FRONT(g_heap);
+	return NULL;
+}
+
+U32 k_memory_block_size(void *p_mem_blk)
+{
+	int i;
+	const int pool = k_memory_block_pool(p_mem_blk, &i);
+	return pool == -1 ? MEM_BLOCK_SIZE : g_mem_pools[pool].m_block_size;
+}
+
+bool k_memory_is_block(void *p_mem_blk)
+{
+	return k_memory_block_index(p_mem_blk) != -1;
+}
+
+void k_memory_set_owner(void *p_mem_blk, int pid)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+	if (i != -1) {
+		g_mem_holders[i] = pid == NO_OWNER ? 0 : PID_BIT(pid);
+	}
+}
+
+void k_memory_hand_over(void *p_mem_blk, int from_pid, int to_pid)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+	if (i == -1) {
+		return;
+	}
+	if (g_mem_holders[i] & PID_BIT(from_pid)) {
+		g_mem_holders[i] = (g_mem_holders[i] & ~PID_BIT(from_pid)) | PID_BIT(to_pid);
+	} else {
+		// An i-process sends blocks it took while another process was running
+		assert(!k_memory_is_shared(p_mem_blk));
+		g_mem_holders[i] = PID_BIT(to_pid);
+	}
+}
+
+bool k_memory_retain(void *p_mem_blk, int pid)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+	if (i == -1 || (g_mem_holders[i] & PID_BIT(pid))) {
+		return false;
+	}
+	g_mem_holders[i] |= PID_BIT(pid);
+	return true;
+}
+
+void k_memory_drop_shared(void *p_mem_blk, int pid)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+	assert(i != -1 && (g_mem_holders[i] & ~PID_BIT(pid)));
+	g_mem_holders[i] &= ~PID_BIT(pid);
+}
+
+bool k_memory_holds(void *p_mem_blk, int pid)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+	return i != -1 && (g_mem_holders[i] & PID_BIT(pid));
+}
+
+bool k_memory_is_shared(void *p_mem_blk)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+	// More than one bit set
+	return i != -1 && (g_mem_holders[i] & (g_mem_holders[i] - 1));
+}
+
+void k_memory_set_queued(void *p_mem_blk, bool queued)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+	if (i == -1) {
+		return;
+	}
+	if (queued) {
+		MEM_QUEUED_WORD(i) |= MEM_USED_BIT(i);
+	} else {
+		MEM_QUEUED_WORD(i) &= ~MEM_USED_BIT(i);
+	}
+}
+
+bool k_memory_is_queued(void *p_mem_blk)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+	return i != -1 && (MEM_QUEUED_WORD(i) & MEM_USED_BIT(i));
+}
+
+/**
+ * @brief: hand a free block to a process waiting for memory, or put it back in its pool.
+ *         Processes waiting on a smaller pool can take it too.
+ * @return: whether a process got it
+ */
+static bool k_memory_give_back(void *p_mem)
+{
+	int i;
+	const int pool = k_memory_block_pool(p_mem, &i);
+	for (int wanted = pool; wanted >= 0; --wanted) {
+		const pid_t waiter = k_memory_handoff(wanted, p_mem);
+		if (waiter != PID_NONE) {
+			k_memory_set_owner(p_mem, waiter);
+			k_trace(TRACE_ALLOC, waiter, i);
+			return true;
+		}
+	}
+	k_memory_set_owner(p_mem, NO_OWNER);
+	MEM_USED_WORD(i) &= ~MEM_USED_BIT(i);
+	k_memory_push_free(&g_mem_pools[pool], p_mem);
+	return false;
+}
+
+// Drop pid's reference to block i. Returns whether it was the last one.
+static bool k_memory_drop(int i, int pid)
+{
+	g_mem_holders[i] &= ~PID_BIT(pid);
+	return g_mem_holders[i] == 0;
+}
+
+int k_memory_release_owned(int pid)
+{
+	int released = 0;
+	for (int i = 0; i < g_num_mem_blocks; ++i) {
+		if ((g_mem_holders[i] & PID_BIT(pid)) && k_memory_drop(i, pid)) {
+			k_trace(TRACE_FREE, pid, i);
+			k_memory_give_back(k_memory_block_at(i));
+			++released;
+		}
+	}
+	return released;
+}
+
+/**
+ * @brief: a block from pool for the running process, without blocking.
+ *         If pool is empty, a block from a larger pool will do.
+ * @return: NULL if they're all empty
+ */
+static void *k_memory_alloc(int pool)
+{
+	U8 *p_mem_blk = k_memory_take_handoff();
+
+	// Released to us while we were blocked, it's already ours
+	if (p_mem_blk == NULL) {
+		while (pool < NUM_MEM_POOLS && g_mem_pools[pool].m_num_free == 0) {
+			++pool;
+		}
+		if (pool == NUM_MEM_POOLS) {
+			return NULL;
+		}
+		p_mem_blk = (U8 *)k_memory_pop_free(&g_mem_pools[pool]);
+		const int i = k_memory_block_index(p_mem_blk);
+		MEM_USED_WORD(i) |= MEM_USED_BIT(i);
+		k_memory_set_owner(p_mem_blk, k_running_pid());
+		k_trace(TRACE_ALLOC, k_running_pid(), i);
+	}
+	// A new block has no delayed send pending, whatever the last owner left in it
+	memset(((MSG_BUF *)p_mem_blk)->m_kdata, 0, sizeof(((MSG_BUF *)p_mem_blk)->m_kdata));
 	return (void *)p_mem_blk;	//this is pointing the content not the header
 }
 
-int k_release_memory_block_valid(void *p_mem_blk)
+void *k_request_memory_block(void)
 {
-  //when the block is returned adjust the pointer so it points to start of envelope i.e. from header
-	mem_t *const p_mem = (mem_t *)p_mem_blk;
-  if(p_mem == NULL){
-    return RTX_ERR;
-  }
+	return k_request_memory_block_sized(MEM_BLOCK_SIZE);
+}
 
-	const unsigned long offset = (unsigned long)p_mem - (unsigned long)mem_blocks;
-  if(offset >= sizeof(mem_blocks)) {
-    return RTX_ERR;
-  }
-  if(offset % MEM_BLOCK_SIZE != 0){
+/**
+ * @brief: a block of at least size bytes, from the smallest pool that has one
+ *         free. Blocks until the smallest pool that fits has one released.
+ * @return: NULL if no pool's blocks are that large
+ */
+void *k_request_memory_block_sized(int size)
+{
+	if (size <= 0) {
+		return NULL;
+	}
+	int pool = 0;
+	while (pool < NUM_MEM_POOLS && g_mem_pools[pool].m_block_size < size) {
+		++pool;
+	}
+	if (pool == NUM_MEM_POOLS) {
+		return NULL;
+	}
+
+	void *const p_mem_blk = k_memory_alloc(pool);
+	if (p_mem_blk == NULL) {
+		// Restarted once a block is released
+		k_memory_wait_for(pool);
+		k_poll(BLOCKED_ON_RESOURCE);
+	}
+	return p_mem_blk;
+}
+
+/**
+ * @brief: request_memory_block that gives up after ms milliseconds.
+ *         A timeout takes the process off the blocked on memory queue,
+ *         and its restarted call returns NULL.
+ * @return: NULL if it timed out, or ms isn't positive and the heap is empty
+ */
+void *k_request_memory_block_timeout(int ms)
+{
+	disable_irq();
+	void *const p_mem_blk = k_memory_alloc(MEM_POOL_DEFAULT);
+	if (p_mem_blk == NULL && ms > 0 && !k_timeout_expired()) {
+		// Restarted once a block is released or the timeout expires
+		k_memory_wait_for(MEM_POOL_DEFAULT);
+		k_poll_timeout(BLOCKED_ON_RESOURCE, ms);
+		enable_irq();
+		return NULL;
+	}
+	k_end_timeout();
+	enable_irq();
+	return p_mem_blk;
+}
+
+int k_release_memory_block_valid(void *p_mem_blk)
+{
+	const int i = k_memory_block_index(p_mem_blk);
+  if(i == -1){
     return RTX_ERR;
   }
-	// Check if the memory block is already free i.e. already in the list
-	mem_t *blk;
-	LL_FOREACH(blk, g_heap) {
-		if (blk == p_mem) {
-			return RTX_ERR;
-		}
+	// Check if the memory block is already free i.e. already in the heap
+	if (!(MEM_USED_WORD(i) & MEM_USED_BIT(i))) {
+		return RTX_ERR;
 	}
   return RTX_OK;
 }
 
 int k_release_memory_block(void *p_mem_blk)
 {
+	// The kernel delivers a periodic message again, until it's cancelled
+	if (k_is_periodic_message(p_mem_blk)) {
+		return RTX_ERR;
+	}
 	//if memory block pointer being released is valid
 	if(k_release_memory_block_valid(p_mem_blk) == RTX_OK){
-    mem_t *p_mem = (mem_t *)p_mem_blk;
-    LL_PUSH_BACK(g_heap, p_mem);
-
-	k_check_preemption();
+    const int i = k_memory_block_index(p_mem_blk);
+    const pid_t pid = k_running_pid();
+    // Only a holder can release it. A block it sent belongs to the receiver now.
+    if (!(g_mem_holders[i] & PID_BIT(pid))) {
+      return RTX_ERR;
+    }
+    // Freeing it would leave a mailbox or the delayed message wheel pointing into the heap
+    if (k_message_in_flight(p_mem_blk, pid)) {
+      return RTX_ERR;
+    }
+    // Shared blocks are freed by their last holder
+    if (k_memory_drop(i, pid)) {
+      k_trace(TRACE_FREE, pid, i);
+      // Only the process that gets the block wakes up, and it may preempt us
+      if (k_memory_give_back(p_mem_blk)) {
+        k_check_preemption();
+      }
+    }
 	}
 	else{
 		return RTX_ERR;
 	}
 	return RTX_OK;
 }
-
-int k_memory_heap_free_blocks(void) {
-	return LL_SIZE(g_heap);
-}
+
+int k_memory_heap_free_blocks(void) {
+	int free = 0;
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		free += g_mem_pools[pool].m_num_free;
+	}
+	return free;
+}
+
+static void put_dec(U32 value)
+{
+	char digits[10];
+	int n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	while (n > 0) {
+		uart1_put_char(digits[--n]);
+	}
+}
+
+/**
+ * @brief: say how many blocks of each size memory_init found room for, on UART1
+ */
+void k_memory_report(void)
+{
+	uart1_put_string("Heap:");
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		uart1_put_char(' ');
+		put_dec(g_mem_pools[pool].m_num_blocks);
+		uart1_put_string(" x ");
+		put_dec(g_mem_pools[pool].m_block_size);
+		uart1_put_string(pool == NUM_MEM_POOLS - 1 ? "B" : "B,");
+	}
+	uart1_put_string(" in ");
+#ifdef HEAP_IN_AHB_SRAM
+	put_dec(gp_heap_end_addr - gp_heap_begin_addr + gp_ahb_heap_end_addr - (U8 *)AHB_SRAM_BEGIN_ADDR);
+#else
+	put_dec(gp_heap_end_addr - gp_heap_begin_addr);
+#endif
+	uart1_put_string(" bytes\n\r");
+}
+
+#ifdef _DEBUG_HOTKEYS
+void k_print_memory_blocks(void) {
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		printf("%u byte blocks: %d free of %d\n", g_mem_pools[pool].m_block_size,
+			g_mem_pools[pool].m_num_free, g_mem_pools[pool].m_num_blocks);
+	}
+	printf("Memory blocks in use:\n");
+	for (int i = 0; i < g_num_mem_blocks; ++i) {
+		if (!(MEM_USED_WORD(i) & MEM_USED_BIT(i))) {
+			continue;
+		}
+		printf("  Block %d at 0x%08x held by", i, (unsigned long)k_memory_block_at(i));
+		for (int pid = 0; pid < NUM_PROCS; ++pid) {
+			if (g_mem_holders[i] & PID_BIT(pid)) {
+				printf(" %d", pid);
+			}
+		}
+		printf("\n");
+	}
+}
+#endif
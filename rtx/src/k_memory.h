@@ -7,20 +7,30 @@
 
 #ifndef K_MEM_H_
 #define K_MEM_H_
-
-#include "k_rtx.h"
+
+#include "k_rtx.h"
 #include "k_process.h"
 #include "list.h"
 
 #include "allow_k.h"
 
-typedef struct mem_t{
-	// Guarantee 8-byte alignment, the largest common alignment
-	U32 m_val[(MEM_BLOCK_SIZE + 3) / 4] __attribute__ ((aligned (8)));
-} mem_t;
-
 /* ----- Definitions ----- */
 #define RAM_END_ADDR 0x10008000
+/* The two 16 KB AHB SRAM banks, which are contiguous */
+#define AHB_SRAM_BEGIN_ADDR 0x2007C000
+#define AHB_SRAM_END_ADDR   0x20084000
+
+/* Stacks are filled with this when they're allocated, so the words a process
+   never touched can be counted. See k_get_stack_usage. */
+#define STACK_PAINT 0xA5A5A5A5
+/* The bottom of every stack is a guard it must never reach, the smallest MPU region.
+   Stacks start at a multiple of it. */
+#define STACK_GUARD_SIZE 32
+
+/* Stack sizes of the processes in g_proc_table, which stack_space is sized for */
+#define SYS_SZ_STACK 0x100         /* the null process and the other system processes */
+#define NUM_SYS_SZ_STACK 5         /* how many of them have SYS_SZ_STACK */
+#define TOP_SZ_STACK 0x200         /* top formats its whole report on its stack */
 
 /* ----- Variables ----- */
 /* This symbol is defined in the scatter file (see RVCT Linker User Guide) */
@@ -30,12 +40,43 @@ extern unsigned int Image$$RW_IRAM1$$ZI$$Limit;
 void memory_init(void);
 
 U32 *alloc_stack(U32 size_b);
+U32 *alloc_pool_stack(U32 size_b);
+void free_pool_stack(U32 *sp);
 
 void *k_request_memory_block(void);
+void *k_request_memory_block_timeout(int ms);
+void *k_request_memory_block_sized(int size);
+
+int k_release_memory_block(void *);
 
-int k_release_memory_block(void *);
-
 int k_memory_heap_free_blocks(void);
+// Print the size of each pool on UART1, once memory_init has carved them
+void k_memory_report(void);
+
+// Whether p_mem_blk is the start of a heap block
+bool k_memory_is_block(void *p_mem_blk);
+// The size of the pool p_mem_blk is from, MEM_BLOCK_SIZE if it's outside the heap
+U32 k_memory_block_size(void *p_mem_blk);
+// Make pid the only holder of a block. Ignores pointers outside the heap, like static messages.
+void k_memory_set_owner(void *p_mem_blk, int pid);
+// Hand from_pid's reference to a block to to_pid, as sending does
+void k_memory_hand_over(void *p_mem_blk, int from_pid, int to_pid);
+// Give pid a reference to a block too. false if it already has one.
+bool k_memory_retain(void *p_mem_blk, int pid);
+// Drop pid's reference to a block that others still hold
+void k_memory_drop_shared(void *p_mem_blk, int pid);
+bool k_memory_holds(void *p_mem_blk, int pid);
+// Whether more than one process holds a reference to a block
+bool k_memory_is_shared(void *p_mem_blk);
+// Whether a block is linked into a mailbox through its own mp_next. Ignores pointers outside the heap.
+void k_memory_set_queued(void *p_mem_blk, bool queued);
+bool k_memory_is_queued(void *p_mem_blk);
+// Free every block pid owns. Returns the number freed.
+int k_memory_release_owned(int pid);
+
+#ifdef _DEBUG_HOTKEYS
+void k_print_memory_blocks(void);
+#endif
 
 #include "disallow_k.h"
 #endif /* ! K_MEM_H_ */
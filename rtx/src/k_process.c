@@ -1,501 +1,1505 @@
-/**
- * @file:   k_process.c
- * @brief:  process management C file
- * @author: Yiqing Huang
- * @author: Thomas Reidemeister
- * @date:   2014/02/28
- * NOTE: The example code shows one way of implementing context switching.
- *       The code only has minimal sanity check. There is no stack overflow check.
- *       The implementation assumes only two simple user processes and NO HARDWARE INTERRUPTS.
- *       The purpose is to show how context switch could be done under stated assumptions.
- *       These assumptions are not true in the required RTX Project!!!
- *       If you decide to use this piece of code, you need to understand the assumptions and
- *       the limitations.
- *@Modified: Pushpak Kumar 2016/02/27
- */
-
-#include <LPC17xx.h>
-#include <system_LPC17xx.h>
-#include "uart_polling.h"
-#include "k_process.h"
-#include "sys_proc.h"
-#include "list.h"
-#include "kcd.h"
-#include "crt.h"
-// for NULL_PRIO
-#include "rtx.h"
-#include <assert.h>
-#include "priority_queue.h"
-#include "message_queue.h"
-#include "k_memory.h"
-#include "timer.h"
+/**
+ * @file:   k_process.c
+ * @brief:  process management C file
+ * @author: Yiqing Huang
+ * @author: Thomas Reidemeister
+ * @date:   2014/02/28
+ * NOTE: The example code shows one way of implementing context switching.
+ *       The code only has minimal sanity check. Stack overflows trap, see k_mpu_guard.
+ *       The implementation assumes only two simple user processes and NO HARDWARE INTERRUPTS.
+ *       The purpose is to show how context switch could be done under stated assumptions.
+ *       These assumptions are not true in the required RTX Project!!!
+ *       If you decide to use this piece of code, you need to understand the assumptions and
+ *       the limitations.
+ *@Modified: Pushpak Kumar 2016/02/27
+ */
+
+#include <LPC17xx.h>
+#include <system_LPC17xx.h>
+#include "uart_polling.h"
+#include "k_process.h"
+#include "sys_proc.h"
+#include "list.h"
+#include "kcd.h"
+#include "crt.h"
+// for NULL_PRIO
+#include "rtx.h"
+#include <assert.h>
+#include <stddef.h>
+#include "bitmap_queue.h"
+#include "timer_wheel.h"
+#include "k_memory.h"
+#include "timer.h"
 #include "printf.h"
-#include "allow_k.h"
-
-/* ----- Global Variables ----- */
-#define STATIC
-STATIC PCB process[NUM_PROCS];   /* array of processes */
-const static pid_t PID_NONE = -1;
-STATIC pid_t running = PID_NONE; /* always point to the current RUN process */
-
-// Array of blocked PIDs
-//LL_DECLARE(static blocked[NUM_PROC_STATES][NUM_PRIORITIES], pid_t, NUM_PROCS);
-
-/* array of list of processes that are in BLOCKED_ON_RESOURCE state, one for each priority */
-//#define g_blocked_on_resource_queue (blocked[BLOCKED_ON_RESOURCE])
-LL_DECLARE(static g_blocked_on_resource_queue[NUM_PRIORITIES], pid_t, NUM_PROCS);
-
-/* array of list of processes that are in RDY state, one for each priority */
-//#define g_ready_queue (blocked[RDY])
-LL_DECLARE(static g_ready_queue[NUM_PRIORITIES], pid_t, NUM_PROCS);
-
-/* array of message queues (mailbox) for each processes */
-LL_DECLARE(static g_message_queues[NUM_PROCS], MSG_BUF *, NUM_MEM_BLOCKS + 2);
-
-/* delayed queue for messages */
-static message_queue_t g_delayed_msg_queue = NULL;
-
-
-static void infinite_loop(void)
-{
-	for (;;) {
-	}
-}
-
-/* process initialization table */
-const static PROC_INIT g_proc_table[] = {
-	// m_pid           m_priority      m_stack_size  mpf_start_pc
-	{PID_NULL,         NULL_PRIO,      0x100,        &infinite_loop},
-	{PID_CLOCK,        HIGHEST,        0x100,        &proc_clock},
-	{PID_KCD,          HIGHEST,        0x100,        &proc_kcd},
-	{PID_CRT,          HIGHEST,      	 0x100,        &proc_crt},
-	{PID_SET_PRIO,		 HIGHEST,				 0x100,				 &proc_set_prio},
-};
-extern PROC_INIT g_test_procs[NUM_TEST_PROCS];
-
-
-static void initialize_processes(const PROC_INIT *const inits, int num) {
-	/* initilize exception stack frame (i.e. initial context) for each process */
-	for ( int i = 0; i < num; i++ ) {
-		int j;
-		const PROC_INIT *const init = &inits[i];
-		int pid = init->m_pid;
-		// Check to make sure we're not overwriting a process
-		assert(pid < NUM_PROCS);
-		assert(!process[pid].mp_sp);
-		process[pid].m_pid = pid;
-		process[pid].m_state = NEW;
-		process[pid].m_priority = init->m_priority;
-	
-		// Push processes onto ready queue
-		push_process(g_ready_queue, pid, process[pid].m_priority);
-	
-		// Initializing stack pointer for each pcb
-		U32 *sp = alloc_stack(init->m_stack_size);
-		*(--sp)  = INITIAL_xPSR;      // user process initial xPSR
-		*(--sp)  = (U32)(init->mpf_start_pc); // PC contains the entry point of the process
-		for ( j = 0; j < 6; j++ ) { // R0-R3, R12 are cleared with 0
-			*(--sp) = 0x0;
-		}
-
-		assert(sp);
-		process[pid].mp_sp = sp;
-	}
-}
-
-/**
- * @biref: initialize all processes in the system
- * NOTE: We assume there are only two user processes in the system in this example.
- */
-void process_init()
-{
-  /* fill out the test initialization table */
-	set_test_procs();
-
-	// Make sure we have the right number of non-test processes
-	// Fix this in k_process.h
-	initialize_processes(g_proc_table, sizeof(g_proc_table) / sizeof(g_proc_table[0]));
-	initialize_processes(g_test_procs, NUM_TEST_PROCS);
-	// Make sure we got all the PIDs, or fill them with null
-	for (int i = 0; i < NUM_PROCS; ++i) {
-		if (process[i].mp_sp) {
-			continue;
-		}
-		process[i] = (PCB) {
-			.mp_sp = NULL,
-			.m_pid = i,
-			.m_state = NEW,
-			.m_priority = IPROC_PRIO,
-		};
-	}
-}
-
-/*@brief: scheduler, pick the pid of the next to run process
- *POST: 0 <= running && running < NUM_PROCS
- */
-
-static void scheduler(void)
-{
-		int peek_priority;
-		int peek_pid = peek_front(g_ready_queue, &peek_priority);
-	
-		if(running != PID_NONE && peek_priority > process[running].m_priority &&
-				(process[running].m_state != BLOCKED_ON_RESOURCE && process[running].m_state != BLOCKED_ON_RECEIVE)) {
-			return;
-		}
-		
-		int pid = pop_first_process(g_ready_queue);
-		
-		if(pid == -1) {
-			running = PID_NULL;
-			return;
-		}
-
-		running = pid;
-}
-
-/*@brief: switch out old process (old_pid), run the new pcb (running)
- *@param: old_pid, the pid of the old process that was in RUN
- *@return: RTX_OK upon success
- *         RTX_ERR upon failure
- *PRE:  old_pid and running are valid pids.
- */
-static int process_switch(pid_t old_pid)
-{
-	const PROC_STATE_E state = process[running].m_state;
-
-	if (state == NEW) {
-		if (old_pid != PID_NONE) {
-			assert(running != old_pid);
-			PCB *const p_pcb_old = &process[old_pid];
-			assert(p_pcb_old->m_state != NEW);
-			p_pcb_old->mp_sp = (U32 *) __get_MSP();
-		}
-		process[running].m_state = RUN;
-		__set_MSP((U32) process[running].mp_sp);
-		__rte();  // pop exception stack frame from the stack for a new processes
-	}
-
-	/* The following will only execute if the if block above is FALSE */
-
-	if (running != old_pid) {
-		if (state == RDY) {
-			if (old_pid != PID_NONE) {
-				PCB *const p_pcb_old = &process[old_pid];
-				assert(p_pcb_old->m_state != NEW);
-				p_pcb_old->mp_sp = (U32 *) __get_MSP(); // save the old process's sp
-			}
-			process[running].m_state = RUN;
-			__set_MSP((U32) process[running].mp_sp); //switch to the new proc's stack
-		} else {
-			running = old_pid; // revert back to the old proc on error
-			assert(false);
-			return RTX_ERR;
-		}
-	}
-	return RTX_OK;
-}
-
-/**
- * @brief release_processor().
- * @return RTX_ERR on error and zero on success
- * POST: running gets updated to next to run process
- */
-int k_release_processor(void)
-{
-	pid_t old_pid = running;
-	scheduler();
-
-	if (running == old_pid) {
-		return RTX_OK;
-	}
-	/*
-		what if current state is running? and change to blocked?
-
-		but this changes a ton of things, breaks state assumptions
-		e.g. can't assume cur proc. is running in scheduler
-
-		before: ready queue,
-		after:  blocked queue
-
-		svc indirect calls release processor, user space calls it
-
-	*/
-
-	if (old_pid != PID_NONE) {
-		PCB *const p_pcb_old = &process[old_pid];
-		switch (p_pcb_old->m_state) {
-			case BLOCKED_ON_RESOURCE:
-				push_process(g_blocked_on_resource_queue, p_pcb_old->m_pid, p_pcb_old->m_priority);
-				break;
-			case BLOCKED_ON_RECEIVE:
-				break;
-			case RUN:
-				p_pcb_old->m_state = RDY;
-			case RDY: // fall-through
-				push_process(g_ready_queue, p_pcb_old->m_pid, p_pcb_old->m_priority);
-				break;
-			default:
-				assert(false);
-		}
-	}
-
-	process_switch(old_pid);
-
-	return RTX_OK;
-}
-
-int k_set_process_priority(int process_id, int priority) {
-	// TODO check if this is correct, according to the spec.
-	// "The priority of the null process may not be changed from level 4"
-	if (process_id == PID_NULL && priority == NULL_PRIO) {
-		return RTX_OK;
-	}
-	// Check for invalid values
-	if(process_id < 1 || process_id >= NUM_PROCS || priority < 0 || priority >= NULL_PRIO) {
-		return RTX_ERR;
-	}
-
-
-	PCB *p_pcb = &process[process_id];
-
-	// If priority is the same already, then just return
-	if(p_pcb->m_priority == priority) {
-		return RTX_OK;
-	}
-
-	change_priority(g_ready_queue, process_id, p_pcb->m_priority, priority);
-	change_priority(g_blocked_on_resource_queue, process_id, p_pcb->m_priority, priority);
-
-	p_pcb->m_priority = priority;
-
-	k_check_preemption();
-
-	return RTX_OK;
-}
-
-int k_get_process_priority(int process_id) {
-
-	// Check for invalid pid values
-	if(process_id < PID_NULL || process_id >= NUM_PROCS) {
-		return RTX_ERR;
-	}
-
-	// Get the pcb from the pid
-	PCB *p_pcb = &process[process_id];
-
-	return p_pcb->m_priority;
-}
-
-int k_internal_get_process_priority(int pid) {
-	if (0 <= pid && pid < NUM_PROCS) {
-		return process[pid].m_priority;
-	}
-	return NUM_PRIORITIES;
-}
-
-static void k_check_preemption_impl(bool is_eager) {
-	if (k_memory_heap_free_blocks() > 0) {
-		copy_queue(g_blocked_on_resource_queue, g_ready_queue);
-		
-		for(int i = 0; i < NUM_PROCS; ++i) {
-			PCB* pcb = &process[i];
-			if (pcb->m_priority < NULL_PRIO && pcb->m_state == BLOCKED_ON_RESOURCE) {
-				pcb->m_state = RDY;
-			}
-		}
-	}
-
-	int ready_prio;
-	pid_t ready = peek_front(g_ready_queue, &ready_prio);
-
-	if(ready != PID_NONE) {
-		// We know this won't wrap
-		assert(running != PID_NONE);
-		const int delta = process[running].m_priority - ready_prio;
-		if (is_eager ? delta >= 0 : delta > 0){
-    	k_release_processor();
-		}
-	}
-}
-
-void k_check_preemption(void) {
-	k_check_preemption_impl(false);
-}
-
-void k_check_preemption_eager(void) {
-	disable_irq();
-	static volatile int millis = 0;
-	bool can_preempt = false;
-	millis = (millis + 1) % 100;
-	can_preempt = millis == 0;
-	enable_irq();
-	if (can_preempt) {
-		k_check_preemption_impl(true);
-	}
-}
-
-void k_poll(PROC_STATE_E which) {
-	assert(running != PID_NONE);
-	PCB *const p_pcb = &process[running];
-	p_pcb->m_state = which;
-	switch (which) {
-		case RDY:
-			break;
-		case BLOCKED_ON_RESOURCE:
-			// Hacked in k_release_processor
-			break;
-		case BLOCKED_ON_RECEIVE:
-			// Also hacked in k_release_processor
-			break;
-		default:
-			assert(false);
-	}
-	k_release_processor();
-}
-
-static int k_enqueue_ready_process(pid_t receiver_pid)
-{
-    if(receiver_pid == PID_NONE) {
-        return RTX_ERR;
-    }
-    
-    push_process(g_ready_queue, receiver_pid, process[receiver_pid].m_priority);
-    
-    return RTX_OK;
-}
-
-/**
- * Send a message. Must have IRQ lock.
- */
-void k_send_message_helper(int sender_pid, int receiver_pid, void *p_msg)
-{
-    MSG_BUF *p_msg_envelope = NULL;
-    PCB *p_receiver_pcb = NULL;
-	
-    p_msg_envelope = (MSG_BUF *)((U8 *)p_msg);
-    p_msg_envelope->m_send_pid = sender_pid;
-    p_msg_envelope->m_recv_pid = receiver_pid;
-    
-    p_receiver_pcb = &process[receiver_pid];
-	
-    LL_PUSH_BACK(g_message_queues[receiver_pid], p_msg_envelope);
-		
-    if (p_receiver_pcb->m_state == BLOCKED_ON_RECEIVE) {
-        //if the process was previously in the blocked queue, unblock it and put it in the ready queue
-        p_receiver_pcb->m_state = RDY;
-        k_enqueue_ready_process(receiver_pid);
-    }
-}
-
-static bool validate_message(int receiver_pid, void *p_msg_env) {
-	if (p_msg_env == NULL) {
-		return false;
-	}
-    
-  if (receiver_pid < 0 || receiver_pid >= NUM_PROCS) {
-		return false;
-	}
-	return true;
-}
-
-/*Inter Process Communication Methods*/
-int k_send_message(int receiver_pid, void *p_msg_env)
-{
-	if (!validate_message(receiver_pid, p_msg_env)) {
-		return RTX_ERR;
-	}
-
-	disable_irq();
-	k_send_message_helper(process[running].m_pid, receiver_pid, p_msg_env);
-		//if the receiving process is of higher priority, preemption might happen
-	enable_irq();
-
-	k_check_preemption();
-	
-	return RTX_OK;
-}
-
-void *k_receive_message(int *p_sender_pid)
-{
-	MSG_BUF *p_msg = NULL;
-	
-	disable_irq();
-	while (LL_SIZE(g_message_queues[process[running].m_pid]) == 0) {
-		enable_irq();
-		k_poll(BLOCKED_ON_RECEIVE);
-		disable_irq();
-		assert(LL_SIZE(g_message_queues[process[running].m_pid]) > 0);
-	}
-	
-	assert(LL_SIZE(g_message_queues[running]) > 0);
-	p_msg = (MSG_BUF *)LL_POP_FRONT(g_message_queues[running]);
-	
-	if (p_msg == NULL) {
-		enable_irq();
-		
-			return NULL;
-	}
-	
-	if (p_sender_pid != NULL) {
-		//Note the sender_id is an output parameter and is not meant to filter which message to receive.
-		*p_sender_pid = p_msg->m_send_pid;
-	}
-	
-	enable_irq();
-	
-	return (void *)((U8 *)p_msg);
-}
-
-void *k_non_blocking_receive_message(int pid)
-{
-		disable_irq();
-
-    if (!(LL_SIZE(g_message_queues[pid]) == 0)) {
-        MSG_BUF *p_msg = (MSG_BUF *)LL_POP_FRONT(g_message_queues[pid]);
-        enable_irq();
-				return (void *)((U8 *)p_msg);
-    } else {
-				enable_irq();
-        return NULL;
-    }
-}
-
-int k_delayed_send(int receiver_id, void *p_msg_env, int delay) {
-	if (!validate_message(receiver_id, p_msg_env)) {
-		return RTX_ERR;
-	}
-	
-	// If the delay is zero, that means we do not delay, and we just send the message right away
-	if (delay == 0) {
-		return k_send_message(receiver_id, p_msg_env);
-	}
-	
-		MSG_BUF *const p_msg_envelope = p_msg_env;
-
-		assert(running != PID_NONE);
-    p_msg_envelope->m_send_pid = process[running].m_pid;
-    p_msg_envelope->m_recv_pid = receiver_id;
-		p_msg_envelope->m_kdata[0] = delay + g_timer_count;
-
-	 // insert new message into sorted queue (in desc. order of expiry time)
-    enqueue_message(p_msg_envelope, &g_delayed_msg_queue);
-	
-		return RTX_OK;
-}
-
-void k_check_delayed_messages(void) {
-	disable_irq();
-	for (;;) {
-		MSG_BUF *const msg = dequeue_message(&g_delayed_msg_queue);
-		if (!msg) {
-			break;
-		}
-		k_send_message_helper(msg->m_send_pid, msg->m_recv_pid, msg);
-	}
-	enable_irq();
-}
-
+#include "k_trace.h"
+#include "k_cycle_count.h"
+#include "allow_k.h"
+
+/* ----- Global Variables ----- */
+#define STATIC
+STATIC PCB process[NUM_PROCS];   /* array of processes */
+STATIC pid_t running = PID_NONE; /* always point to the current RUN process */
+
+// Array of blocked PIDs
+//LL_DECLARE(static blocked[NUM_PROC_STATES][NUM_PRIORITIES], pid_t, NUM_PROCS);
+
+/* processes that are in BLOCKED_ON_RESOURCE state, by the pool they wait on, then priority */
+static bitmap_queue_t g_blocked_on_resource_queue[NUM_MEM_POOLS];
+
+/* processes that are in RDY state, by priority */
+static bitmap_queue_t g_ready_queue;
+
+/* RDY, but not in g_ready_queue, since the next switch goes straight to it. See k_direct_switch */
+static pid_t g_direct_pid = PID_NONE;
+
+/* CPU accounting. The cycles since g_account_since are charged to g_account_pid. */
+static U32 g_cpu_cycles[NUM_PROCS];
+static U32 g_cpu_switches[NUM_PROCS];
+static pid_t g_account_pid = PID_NONE;
+static U32 g_account_since = 0;
+
+/* Each process's mailbox, oldest message first. An entry is either a message,
+   linked through its mp_next, or a mail_link_t for a block that's shared,
+   since that may be in several mailboxes at once. */
+typedef struct mailbox {
+	void *mp_front;
+	void *mp_back;
+} mailbox_t;
+static mailbox_t g_mailboxes[NUM_PROCS];
+
+/* Like MSG_BUF, mp_next comes first */
+typedef struct mail_link {
+	void *mp_next;
+	MSG_BUF *mp_msg;
+} mail_link_t;
+#define NUM_MAIL_LINKS 32
+static mail_link_t g_mail_links[NUM_MAIL_LINKS];
+static mail_link_t *gp_free_mail_links = NULL;
+static int g_num_free_mail_links = 0;
+
+/* delayed messages and sleeping processes, by expiry time.
+   Each message's timer is in its m_kdata, and each process's in its PCB. */
+static timer_wheel_t g_delayed_msg_wheel;
+#define MSG_TIMER(msg) ((timer_node_t *)(msg)->m_kdata)
+#define TIMER_MSG(node) ((MSG_BUF *)((U8 *)(node) - offsetof(MSG_BUF, m_kdata)))
+typedef char pids_fit_in_recv_mask[NUM_PROCS <= 32 ? 1 : -1];
+typedef char min_stack_fits_context_and_guard[MIN_SZ_STACK >= 16 * sizeof(U32) + STACK_GUARD_SIZE ? 1 : -1];
+typedef char timer_node_fits_in_kdata[sizeof(timer_node_t) <= sizeof(((MSG_BUF *)0)->m_kdata) ? 1 : -1];
+
+/* periodic messages, whose timers outlive each delivery. A free entry has no mp_msg. */
+#define NUM_PERIODIC_MSGS 4
+typedef struct periodic_msg {
+	timer_node_t m_timer;   /* first, so the timer is the entry */
+	MSG_BUF *mp_msg;        /* the envelope, delivered again every period */
+	U32 m_period;
+	bool m_queued;          /* waiting in the receiver's mailbox */
+	bool m_delivered;       /* sent at least once, so the receiver may be holding it */
+} PERIODIC_MSG;
+static PERIODIC_MSG g_periodic_msgs[NUM_PERIODIC_MSGS];
+
+
+static int k_ready_priority(pid_t pid);
+static PERIODIC_MSG *k_find_periodic_message(const void *p_msg_env);
+static void k_periodic_message_received(void *p_msg_env);
+static pid_t k_account(pid_t pid);
+
+/* The null process sleeps until the next interrupt, which is the next
+   deadline in g_delayed_msg_wheel under tickless idle */
+static void null_process(void)
+{
+	for (;;) {
+		__WFI();
+	}
+}
+
+/* process initialization table */
+const static PROC_INIT g_proc_table[] = {
+	// m_pid           m_priority      m_stack_size  mpf_start_pc
+	{PID_NULL,         NULL_PRIO,      SYS_SZ_STACK, &null_process},
+	{PID_CLOCK,        HIGHEST,        SYS_SZ_STACK, &proc_clock},
+	{PID_KCD,          HIGHEST,        SYS_SZ_STACK, &proc_kcd},
+	{PID_CRT,          HIGHEST,        SYS_SZ_STACK, &proc_crt},
+	{PID_SET_PRIO,     HIGHEST,        SYS_SZ_STACK, &proc_set_prio},
+	{PID_TOP,          HIGHEST,        TOP_SZ_STACK, &proc_top},
+};
+extern PROC_INIT g_test_procs[NUM_TEST_PROCS];
+
+
+/* A process that returns from its entry point exits */
+static void process_return(void)
+{
+	exit_process();
+}
+
+/**
+ * @brief: set up a new process and make it ready
+ * @param: sp, the top of its stack
+ */
+static void k_init_process(pid_t pid, int priority, void (*entry)(), U32 *sp, U32 stack_size)
+{
+	int j;
+	process[pid].m_pid = pid;
+	process[pid].m_state = NEW;
+	process[pid].m_priority = priority;
+	// The guard needs an aligned base, so it may take a little more than stack_size
+	process[pid].mp_stack_limit = (U32 *)(((U32)(sp - stack_size / 4)) & ~(STACK_GUARD_SIZE - 1));
+	process[pid].m_stack_size = (sp - process[pid].mp_stack_limit) * sizeof(U32);
+
+	// Push processes onto ready queue
+	bq_push_back(&g_ready_queue, pid, k_ready_priority(pid));
+
+	// Initializing stack pointer for each pcb
+	// The initial context is popped by PendSV_Handler, like any other switch
+	*(--sp)  = INITIAL_xPSR;      // user process initial xPSR
+	*(--sp)  = (U32)entry;        // PC contains the entry point of the process
+	*(--sp)  = (U32)&process_return; // LR
+	for ( j = 0; j < 5; j++ ) { // R12, R0-R3 are cleared with 0
+		*(--sp) = 0x0;
+	}
+	for ( j = 0; j < 8; j++ ) { // R4-R11 are cleared with 0
+		*(--sp) = 0x0;
+	}
+
+	process[pid].mp_sp = sp;
+}
+
+static void initialize_processes(const PROC_INIT *const inits, int num) {
+	/* initilize exception stack frame (i.e. initial context) for each process */
+	for ( int i = 0; i < num; i++ ) {
+		const PROC_INIT *const init = &inits[i];
+		int pid = init->m_pid;
+		// Check to make sure we're not overwriting a process
+		assert(pid <= MAX_PID);
+		assert(!process[pid].mp_sp);
+
+		U32 *sp = alloc_stack(init->m_stack_size);
+		assert(sp);
+		k_init_process(pid, init->m_priority, init->mpf_start_pc, sp, init->m_stack_size);
+	}
+}
+
+/**
+ * @brief: make the guard at the bottom of pid's stack no-access, instead of
+ *         the last running process's. Accessing it traps into MemManage_Handler.
+ */
+static void k_mpu_guard(pid_t pid)
+{
+#ifdef MPU_STACK_GUARD
+	// Region 0, whose size and permissions k_mpu_init set
+	MPU->RBAR = (U32)process[pid].mp_stack_limit | MPU_RBAR_VALID_Msk | 0;
+	__DSB();
+	__ISB();
+#endif
+}
+
+static void k_mpu_init(void)
+{
+#ifdef MPU_STACK_GUARD
+	k_mpu_guard(PID_NULL);
+	// 2^(4 + 1) == STACK_GUARD_SIZE bytes, no access, not executable.
+	// The rest of the memory map is the default one.
+	MPU->RASR = MPU_RASR_XN_Msk | (4 << MPU_RASR_SIZE_Pos) | MPU_RASR_ENABLE_Msk;
+	MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+	SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+	__DSB();
+	__ISB();
+#endif
+}
+
+/**
+ * @brief: pid overflowed its stack. Say which on UART1 and stop.
+ */
+static void k_stack_overflow(pid_t pid)
+{
+	__disable_irq();
+	uart1_put_string("\r\nStack overflow in PID ");
+	uart1_put_char('0' + pid / 10);
+	uart1_put_char('0' + pid % 10);
+	uart1_put_string("\r\n");
+#ifdef K_TRACE
+	k_trace_dump();
+#endif
+	for (;;) {
+	}
+}
+
+/**
+ * @brief: MPU fault. Processes only have the guard below their stack, so the
+ *         running process overflowed its stack.
+ */
+void MemManage_Handler(void)
+{
+	k_stack_overflow(running);
+}
+
+/* PendSV_Handler saves R4-R11 of the "old process" before the first switch, too */
+static U32 g_boot_psp_frame[8];
+
+/**
+ * @biref: initialize all processes in the system
+ * NOTE: We assume there are only two user processes in the system in this example.
+ */
+void process_init()
+{
+	__set_PSP((U32)(g_boot_psp_frame + 8));
+
+  /* fill out the test initialization table */
+	set_test_procs();
+
+	// Make sure we have the right number of non-test processes
+	// Fix this in k_process.h
+	initialize_processes(g_proc_table, sizeof(g_proc_table) / sizeof(g_proc_table[0]));
+	initialize_processes(g_test_procs, NUM_TEST_PROCS);
+	// Make sure we got all the PIDs, or fill them with null
+	for (int i = 0; i < NUM_PROCS; ++i) {
+		if (process[i].mp_sp) {
+			continue;
+		}
+		process[i] = (PCB) {
+			.mp_sp = NULL,
+			.m_pid = i,
+			.m_state = i <= MAX_PID ? NEW : UNUSED,
+			.m_priority = IPROC_PRIO,
+		};
+	}
+	for (int i = 0; i < NUM_MAIL_LINKS; ++i) {
+		g_mail_links[i].mp_next = gp_free_mail_links;
+		gp_free_mail_links = &g_mail_links[i];
+	}
+	g_num_free_mail_links = NUM_MAIL_LINKS;
+	k_mpu_init();
+}
+
+/*@brief: scheduler, pick the pid of the next to run process
+ *POST: 0 <= running && running < NUM_PROCS
+ */
+
+static void scheduler(void)
+{
+		int peek_priority;
+		bq_peek_front(&g_ready_queue, &peek_priority);
+	
+		if (g_direct_pid != PID_NONE) {
+			const pid_t pid = g_direct_pid;
+			g_direct_pid = PID_NONE;
+			// Unless something more urgent became ready in the meantime
+			if (k_ready_priority(pid) <= peek_priority) {
+				running = pid;
+				return;
+			}
+			bq_push_back(&g_ready_queue, pid, k_ready_priority(pid));
+			bq_peek_front(&g_ready_queue, &peek_priority);
+		}
+
+		if(running != PID_NONE && peek_priority > process[running].m_priority &&
+				(process[running].m_state != BLOCKED_ON_RESOURCE && process[running].m_state != BLOCKED_ON_RECEIVE &&
+				process[running].m_state != BLOCKED_ON_TIMER && process[running].m_state != BLOCKED_ON_REPLY &&
+				process[running].m_state != UNUSED)) {
+			return;
+		}
+		
+		int pid = bq_pop_front(&g_ready_queue, NULL);
+		
+		if(pid == -1) {
+			running = PID_NULL;
+			return;
+		}
+
+		running = pid;
+}
+
+/*@brief: switch out old process (old_pid), run the new pcb (running)
+ *@param: old_pid, the pid of the old process that was in RUN
+ *@param: old_sp, the old process's PSP, with R4-R11 already pushed
+ *@return: The new process's PSP, to pop R4-R11 and the exception stack frame from
+ *PRE:  old_pid and running are valid pids.
+ */
+static U32 *process_switch(pid_t old_pid, U32 *old_sp)
+{
+	if (old_pid != PID_NONE) {
+		assert(process[old_pid].m_state != NEW);
+		if (process[old_pid].m_state == UNUSED) {
+			// It exited, and we're off its stack now
+			free_pool_stack(old_sp);
+			process[old_pid].mp_sp = NULL;
+		} else {
+			process[old_pid].mp_sp = old_sp; // save the old process's sp
+		}
+	}
+	if (running != old_pid) {
+		const PROC_STATE_E state = process[running].m_state;
+		assert(state == NEW || state == RDY);
+		process[running].m_state = RUN;
+		k_trace(TRACE_SWITCH, running, old_pid);
+		++g_cpu_switches[running];
+		k_mpu_guard(running);
+		// Only now is the old process's guard readable. If it's been written,
+		// the old process overflowed its stack, into whatever is below it.
+		if (old_pid != PID_NONE && process[old_pid].m_state != UNUSED) {
+			const U32 *const p_guard = process[old_pid].mp_stack_limit;
+			if (old_sp < p_guard + STACK_GUARD_SIZE / 4 || *p_guard != STACK_PAINT) {
+				k_stack_overflow(old_pid);
+			}
+		}
+	}
+	k_account(running);
+	return process[running].mp_sp;
+}
+
+/**
+ * @brief: pick the next process, and queue the old one according to its state.
+ *         Must have IRQ lock. The caller switches to the new process.
+ * @return: the old pid
+ */
+static pid_t k_schedule(void)
+{
+	pid_t old_pid = running;
+	scheduler();
+
+	if (running == old_pid || old_pid == PID_NONE) {
+		return old_pid;
+	}
+
+	PCB *const p_pcb_old = &process[old_pid];
+	switch (p_pcb_old->m_state) {
+		case BLOCKED_ON_RESOURCE:
+			bq_push_back(&g_blocked_on_resource_queue[p_pcb_old->m_mem_pool], p_pcb_old->m_pid, p_pcb_old->m_priority);
+			break;
+		case BLOCKED_ON_RECEIVE:
+		case BLOCKED_ON_TIMER:
+		case BLOCKED_ON_REPLY:
+		case UNUSED:
+			break;
+		case RUN:
+			p_pcb_old->m_state = RDY;
+		case RDY: // fall-through
+			bq_push_back(&g_ready_queue, p_pcb_old->m_pid, k_ready_priority(p_pcb_old->m_pid));
+			break;
+		default:
+			assert(false);
+	}
+	return old_pid;
+}
+
+/* Reasons for the pending PendSV, read and cleared by k_pendsv_handler */
+static volatile bool g_resched_yield = false;
+static volatile bool g_resched_eager = false;
+
+/**
+ * @brief: switch processes once no other exception is active.
+ *         PendSV has the lowest priority, so several ISRs and system calls
+ *         requesting a reschedule result in a single switch.
+ */
+static void k_request_reschedule(void)
+{
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/**
+ * @brief release_processor().
+ * @return RTX_ERR on error and zero on success
+ * POST: running gets updated to next to run process, once PendSV runs
+ */
+int k_release_processor(void)
+{
+	g_resched_yield = true;
+	k_request_reschedule();
+	return RTX_OK;
+}
+
+int k_set_process_priority(int process_id, int priority) {
+	// TODO check if this is correct, according to the spec.
+	// "The priority of the null process may not be changed from level 4"
+	if (process_id == PID_NULL && priority == NULL_PRIO) {
+		return RTX_OK;
+	}
+	// Check for invalid values
+	if(process_id < 1 || process_id >= NUM_PROCS || priority < 0 || priority >= NULL_PRIO) {
+		return RTX_ERR;
+	}
+	if (process[process_id].m_state == UNUSED) {
+		return RTX_ERR;
+	}
+
+
+	PCB *p_pcb = &process[process_id];
+
+	// If priority is the same already, then just return
+	if(p_pcb->m_priority == priority) {
+		return RTX_OK;
+	}
+
+	const bool was_ready = bq_remove(&g_ready_queue, process_id);
+	bitmap_queue_t *const p_blocked = &g_blocked_on_resource_queue[p_pcb->m_mem_pool];
+	const bool was_blocked = bq_remove(p_blocked, process_id);
+
+	p_pcb->m_priority = priority;
+
+	if (was_ready) {
+		bq_push_back(&g_ready_queue, process_id, k_ready_priority(process_id));
+	}
+	if (was_blocked) {
+		bq_push_back(p_blocked, process_id, priority);
+	}
+
+	k_check_preemption();
+
+	return RTX_OK;
+}
+
+int k_get_process_priority(int process_id) {
+
+	// Check for invalid pid values
+	if(process_id < PID_NULL || process_id >= NUM_PROCS || process[process_id].m_state == UNUSED) {
+		return RTX_ERR;
+	}
+
+	// Get the pcb from the pid
+	PCB *p_pcb = &process[process_id];
+
+	return p_pcb->m_priority;
+}
+
+int k_internal_get_process_priority(int pid) {
+	if (0 <= pid && pid < NUM_PROCS) {
+		return process[pid].m_priority;
+	}
+	return NUM_PRIORITIES;
+}
+
+pid_t k_running_pid(void) {
+	return running;
+}
+
+/**
+ * @brief: give a released memory block to the highest priority, longest
+ *         waiting process blocked on memory from pool, and make only that one ready.
+ *         Its restarted request_memory_block returns the block.
+ * @return: the pid it was given to, or PID_NONE if nobody is waiting
+ */
+pid_t k_memory_handoff(int pool, void *p_mem_blk) {
+	disable_irq();
+	const pid_t pid = bq_pop_front(&g_blocked_on_resource_queue[pool], NULL);
+	if (pid != PID_NONE) {
+		assert(process[pid].mp_handoff == NULL);
+		process[pid].mp_handoff = p_mem_blk;
+		process[pid].m_state = RDY;
+		k_trace(TRACE_STATE, pid, RDY);
+		bq_push_back(&g_ready_queue, pid, k_ready_priority(pid));
+	}
+	enable_irq();
+	return pid;
+}
+
+void k_memory_wait_for(int pool) {
+	process[running].m_mem_pool = pool;
+}
+
+void *k_memory_take_handoff(void) {
+	void *const p_mem_blk = process[running].mp_handoff;
+	process[running].mp_handoff = NULL;
+	return p_mem_blk;
+}
+
+/**
+ * @brief: whether the front of g_ready_queue should preempt the running process.
+ *         Must have IRQ lock.
+ */
+static bool k_should_preempt(bool is_eager) {
+	int ready_prio;
+	pid_t ready = bq_peek_front(&g_ready_queue, &ready_prio);
+
+	if(ready != PID_NONE) {
+		// We know this won't wrap
+		assert(running != PID_NONE);
+		const int delta = process[running].m_priority - ready_prio;
+		return is_eager ? delta >= 0 : delta > 0;
+	}
+	return false;
+}
+
+void k_check_preemption(void) {
+	k_request_reschedule();
+}
+
+void k_check_preemption_eager(void) {
+	disable_irq();
+	static volatile int millis = 0;
+	millis = (millis + 1) % 100;
+	if (millis == 0) {
+		g_resched_eager = true;
+		k_request_reschedule();
+	}
+	enable_irq();
+}
+
+/**
+ * @brief: C part of PendSV_Handler in HAL.c. Does the actual preemption.
+ *@param: sp, the running process's PSP
+ *@return: the PSP of the process to run
+ */
+U32 *k_pendsv_handler(U32 *sp) {
+	disable_irq();
+	const bool is_yield = g_resched_yield;
+	const bool is_eager = g_resched_eager;
+	g_resched_yield = g_resched_eager = false;
+
+	pid_t old_pid = running;
+	if (running == PID_NONE || process[running].m_state != RUN ||
+			k_should_preempt(is_eager) || is_yield || g_direct_pid != PID_NONE) {
+		old_pid = k_schedule();
+	}
+	sp = process_switch(old_pid, sp);
+	enable_irq();
+	return sp;
+}
+
+/**
+ * @brief: C part of SVC_Handler in HAL.c, after the kernel function returns.
+ *         If the caller blocked, its PC is rewound to the SVC instruction,
+ *         so the system call restarts with the same arguments once it's woken up,
+ *         including by a timeout, which the restarted call sees with k_timeout_expired.
+ *         A sleeping process has nothing to retry, so sleep just returns.
+ *@param: ret, the kernel function's return value
+ *@param: frame, the caller's exception stack frame
+ */
+void k_svc_return(U32 ret, U32 *frame) {
+	if (running != PID_NONE) {
+		const PROC_STATE_E state = process[running].m_state;
+		if (state == BLOCKED_ON_RESOURCE || state == BLOCKED_ON_RECEIVE || state == BLOCKED_ON_REPLY) {
+			frame[6] -= 2; // PC, SVC is a 16-bit instruction
+			return;
+		}
+	}
+	frame[0] = ret;
+}
+
+void k_poll(PROC_STATE_E which) {
+	assert(running != PID_NONE);
+	PCB *const p_pcb = &process[running];
+	p_pcb->m_state = which;
+	k_trace(TRACE_STATE, running, which);
+	switch (which) {
+		case RDY:
+			break;
+		case BLOCKED_ON_RESOURCE:
+			// Hacked in k_schedule
+			break;
+		case BLOCKED_ON_RECEIVE:
+			// Also hacked in k_schedule
+			break;
+		case BLOCKED_ON_TIMER:
+			// On g_delayed_msg_wheel, see k_sleep
+			break;
+		case BLOCKED_ON_REPLY:
+			// Woken up by k_reply, or by k_exit_process of the callee
+			break;
+		default:
+			assert(false);
+	}
+	// Switch once the system call returns. SVC_Handler restarts it when we're woken up.
+	k_request_reschedule();
+}
+
+/**
+ * The priority a process is queued at in g_ready_queue.
+ * KCD and CRT run ahead of other HIGHEST processes, to keep the console responsive.
+ */
+static int k_ready_priority(pid_t pid)
+{
+	if ((pid == PID_KCD || pid == PID_CRT) && process[pid].m_priority == HIGHEST) {
+		return BQ_PRIO_BOOST;
+	}
+	return process[pid].m_priority;
+}
+
+static int k_enqueue_ready_process(pid_t receiver_pid)
+{
+    if(receiver_pid == PID_NONE) {
+        return RTX_ERR;
+    }
+    
+    bq_push_back(&g_ready_queue, receiver_pid, k_ready_priority(receiver_pid));
+    
+    return RTX_OK;
+}
+
+// Whether p_msg is from a sender in pid_mask, and of type mtype unless it's MTYPE_ANY
+static bool k_message_matches(const MSG_BUF *p_msg, U32 pid_mask, int mtype)
+{
+	return (pid_mask & PID_BIT(p_msg->m_send_pid)) && (mtype == MTYPE_ANY || p_msg->mtype == mtype);
+}
+
+/**
+ * @brief: run pid, which was just made RDY, at the next switch without a trip
+ *         through g_ready_queue. Must have IRQ lock.
+ */
+static void k_direct_switch(pid_t pid)
+{
+	assert(process[pid].m_state == RDY && !bq_contains(&g_ready_queue, pid));
+	if (g_direct_pid != PID_NONE) {
+		k_enqueue_ready_process(g_direct_pid);
+	}
+	g_direct_pid = pid;
+	k_request_reschedule();
+}
+
+static bool k_is_mail_link(void *p_entry)
+{
+	return (unsigned long)p_entry - (unsigned long)g_mail_links < sizeof(g_mail_links);
+}
+
+static MSG_BUF *k_mail_entry_msg(void *p_entry)
+{
+	return k_is_mail_link(p_entry) ? ((mail_link_t *)p_entry)->mp_msg : (MSG_BUF *)p_entry;
+}
+
+/**
+ * @brief: take p_entry, which follows p_prev (NULL for the front), out of pid's mailbox.
+ *         Must have IRQ lock.
+ * @return: its message
+ */
+static MSG_BUF *k_mailbox_unlink(pid_t pid, void *p_prev, void *p_entry)
+{
+	mailbox_t *const p_box = &g_mailboxes[pid];
+	void *const p_next = *(void **)p_entry;
+	if (p_prev != NULL) {
+		*(void **)p_prev = p_next;
+	} else {
+		p_box->mp_front = p_next;
+	}
+	if (p_box->mp_back == p_entry) {
+		p_box->mp_back = p_prev;
+	}
+
+	MSG_BUF *const p_msg = k_mail_entry_msg(p_entry);
+	if (p_entry != p_msg) {
+		mail_link_t *const p_link = p_entry;
+		p_link->mp_next = gp_free_mail_links;
+		gp_free_mail_links = p_link;
+		++g_num_free_mail_links;
+	} else {
+		k_memory_set_queued(p_msg, false);
+	}
+	return p_msg;
+}
+
+/**
+ * Queue a message in the receiver's mailbox. Must have IRQ lock.
+ * A shared block takes a mail_link_t, which validate_message made sure is free.
+ * @return: whether that woke up the receiver, which the caller then makes ready
+ */
+static bool k_mailbox_push(int sender_pid, int receiver_pid, void *p_msg)
+{
+    MSG_BUF *p_msg_envelope = NULL;
+    PCB *p_receiver_pcb = NULL;
+	
+    p_msg_envelope = (MSG_BUF *)((U8 *)p_msg);
+    p_msg_envelope->m_send_pid = sender_pid;
+    p_msg_envelope->m_recv_pid = receiver_pid;
+    
+    p_receiver_pcb = &process[receiver_pid];
+	
+    void *p_entry = p_msg_envelope;
+    if (k_memory_is_shared(p_msg_envelope)) {
+        mail_link_t *const p_link = gp_free_mail_links;
+        assert(p_link != NULL);
+        gp_free_mail_links = p_link->mp_next;
+        --g_num_free_mail_links;
+        p_link->mp_msg = p_msg_envelope;
+        p_entry = p_link;
+    } else {
+        k_memory_set_queued(p_msg_envelope, true);
+    }
+    mailbox_t *const p_box = &g_mailboxes[receiver_pid];
+    *(void **)p_entry = NULL;
+    if (p_box->mp_back != NULL) {
+        *(void **)p_box->mp_back = p_entry;
+    } else {
+        p_box->mp_front = p_entry;
+    }
+    p_box->mp_back = p_entry;
+    k_trace(TRACE_SEND, sender_pid, receiver_pid);
+		
+    if (p_receiver_pcb->m_state == BLOCKED_ON_RECEIVE && k_message_matches(p_msg_envelope,
+            p_receiver_pcb->m_recv_mask, p_receiver_pcb->m_recv_mtype)) {
+        //if the process was previously in the blocked queue, unblock it
+        p_receiver_pcb->m_state = RDY;
+        k_trace(TRACE_STATE, receiver_pid, RDY);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Send a message. Must have IRQ lock.
+ */
+void k_send_message_helper(int sender_pid, int receiver_pid, void *p_msg)
+{
+    k_memory_hand_over(p_msg, sender_pid, receiver_pid);
+    if (k_mailbox_push(sender_pid, receiver_pid, p_msg)) {
+        k_enqueue_ready_process(receiver_pid);
+    }
+}
+
+/**
+ * @brief: whether p_msg is linked into a mailbox through its own mp_next.
+ *         Only a message outside the heap, which has no bit for it, takes a search.
+ */
+static bool k_mailbox_holds(void *p_msg)
+{
+	if (k_memory_is_block(p_msg)) {
+		return k_memory_is_queued(p_msg);
+	}
+	for (int pid = 0; pid < NUM_PROCS; ++pid) {
+		for (void *p_entry = g_mailboxes[pid].mp_front; p_entry != NULL; p_entry = *(void **)p_entry) {
+			if (p_entry == p_msg) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static bool validate_message(int receiver_pid, void *p_msg_env) {
+	if (p_msg_env == NULL) {
+		return false;
+	}
+    
+  if (receiver_pid < 0 || receiver_pid >= NUM_PROCS) {
+		return false;
+	}
+	if (process[receiver_pid].m_state == UNUSED) {
+		return false;
+	}
+	// Already waiting in the delayed message wheel
+	if (k_memory_is_block(p_msg_env) && tw_pending(MSG_TIMER((MSG_BUF *)p_msg_env))) {
+		return false;
+	}
+	if (k_find_periodic_message(p_msg_env) != NULL) {
+		return false;
+	}
+	// Already waiting in a mailbox. Linking it again would corrupt that one.
+	if (!k_memory_is_shared(p_msg_env) && k_mailbox_holds(p_msg_env)) {
+		return false;
+	}
+	// Only a holder can pass on its reference, and nobody holds two
+	if (k_memory_is_shared(p_msg_env) &&
+			(!k_memory_holds(p_msg_env, running) || (receiver_pid != running && k_memory_holds(p_msg_env, receiver_pid)))) {
+		return false;
+	}
+	// A shared block needs a mail link
+	if (k_memory_is_shared(p_msg_env) && g_num_free_mail_links == 0) {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief: send one block to every process in pid_mask. They share it, so it
+ *         goes back to the heap once each of them has released it.
+ *         Receivers must not change it.
+ * @return: RTX_ERR if it isn't a heap block the running process holds,
+ *          or it can't be sent to every process in pid_mask
+ */
+int k_multicast_message(U32 pid_mask, void *p_msg_env)
+{
+	if (pid_mask == 0 || (pid_mask & ~(PID_BIT(NUM_PROCS) - 1)) || !k_memory_holds(p_msg_env, running)) {
+		return RTX_ERR;
+	}
+	int receivers = 0;
+	for (int pid = 0; pid < NUM_PROCS; ++pid) {
+		if (!(pid_mask & PID_BIT(pid))) {
+			continue;
+		}
+		if (!validate_message(pid, p_msg_env) || (pid != running && k_memory_holds(p_msg_env, pid))) {
+			return RTX_ERR;
+		}
+		++receivers;
+	}
+	// Each of them may need a mail link
+	if (receivers > g_num_free_mail_links) {
+		return RTX_ERR;
+	}
+
+	disable_irq();
+	for (int pid = 0; pid < NUM_PROCS; ++pid) {
+		if (!(pid_mask & PID_BIT(pid))) {
+			continue;
+		}
+		k_memory_retain(p_msg_env, pid);
+		if (k_mailbox_push(running, pid, p_msg_env)) {
+			k_enqueue_ready_process(pid);
+		}
+	}
+	// Our own reference goes with it, unless we sent it to ourselves too
+	if (!(pid_mask & PID_BIT(running))) {
+		k_memory_drop_shared(p_msg_env, running);
+	}
+	enable_irq();
+
+	k_check_preemption();
+	return RTX_OK;
+}
+
+/*Inter Process Communication Methods*/
+int k_send_message(int receiver_pid, void *p_msg_env)
+{
+	if (!validate_message(receiver_pid, p_msg_env)) {
+		return RTX_ERR;
+	}
+
+	disable_irq();
+	k_send_message_helper(process[running].m_pid, receiver_pid, p_msg_env);
+		//if the receiving process is of higher priority, preemption might happen
+	enable_irq();
+
+	k_check_preemption();
+	
+	return RTX_OK;
+}
+
+/**
+ * Take the oldest message in the running process's mailbox that matches,
+ * keeping the order of the rest. Must have IRQ lock.
+ * @return: NULL if none matches
+ */
+static MSG_BUF *k_mailbox_take(int *p_sender_pid, U32 pid_mask, int mtype)
+{
+	// Plain receive always takes the front
+	void *p_prev = NULL;
+	void *p_entry = g_mailboxes[running].mp_front;
+	while (p_entry != NULL && !k_message_matches(k_mail_entry_msg(p_entry), pid_mask, mtype)) {
+		p_prev = p_entry;
+		p_entry = *(void **)p_entry;
+	}
+	if (p_entry == NULL) {
+		return NULL;
+	}
+	MSG_BUF *const p_msg = k_mailbox_unlink(running, p_prev, p_entry);
+	
+	k_trace(TRACE_RECV, running, p_msg->m_send_pid);
+	k_periodic_message_received(p_msg);
+	if (p_sender_pid != NULL) {
+		//Note the sender_id is an output parameter and is not meant to filter which message to receive.
+		*p_sender_pid = p_msg->m_send_pid;
+	}
+	return p_msg;
+}
+
+// Block in receive until a message that matches arrives. Must have IRQ lock.
+static void k_poll_receive(U32 pid_mask, int mtype)
+{
+	process[running].m_recv_mask = pid_mask;
+	process[running].m_recv_mtype = mtype;
+	k_poll(BLOCKED_ON_RECEIVE);
+}
+
+void *k_receive_message(int *p_sender_pid)
+{
+	return k_receive_message_match(p_sender_pid, PID_ANY, MTYPE_ANY);
+}
+
+/**
+ * @brief: receive_message that skips messages from other senders or of other
+ *         types. They stay in the mailbox, and don't wake us up.
+ */
+void *k_receive_message_match(int *p_sender_pid, U32 pid_mask, int mtype)
+{
+	disable_irq();
+	MSG_BUF *const p_msg = k_mailbox_take(p_sender_pid, pid_mask, mtype);
+	if (p_msg == NULL) {
+		// Restarted once a matching message arrives
+		k_poll_receive(pid_mask, mtype);
+	}
+	enable_irq();
+	
+	return (void *)((U8 *)p_msg);
+}
+
+/**
+ * @brief: receive_message that gives up after ms milliseconds
+ * @return: NULL if it timed out, or ms isn't positive and the mailbox is empty
+ */
+void *k_receive_message_timeout(int *p_sender_pid, int ms)
+{
+	disable_irq();
+	MSG_BUF *const p_msg = k_mailbox_take(p_sender_pid, PID_ANY, MTYPE_ANY);
+	if (p_msg == NULL && ms > 0 && !k_timeout_expired()) {
+		process[running].m_recv_mask = PID_ANY;
+		process[running].m_recv_mtype = MTYPE_ANY;
+		// Restarted once a message arrives or the timeout expires
+		k_poll_timeout(BLOCKED_ON_RECEIVE, ms);
+		enable_irq();
+		return NULL;
+	}
+	k_end_timeout();
+	enable_irq();
+	return p_msg;
+}
+
+void *k_non_blocking_receive_message(int *p_sender_pid)
+{
+	disable_irq();
+	MSG_BUF *const p_msg = k_mailbox_take(p_sender_pid, PID_ANY, MTYPE_ANY);
+	enable_irq();
+	return (void *)((U8 *)p_msg);
+}
+
+/**
+ * @brief: receive as many as max messages with one system call,
+ *         blocking until there's at least one
+ * @return: the number received, or RTX_ERR if max isn't positive
+ */
+int k_receive_messages(void *p_msgs[], int p_sender_pids[], int max)
+{
+	if (p_msgs == NULL || max <= 0) {
+		return RTX_ERR;
+	}
+
+	int n = 0;
+	disable_irq();
+	for (; n < max; ++n) {
+		MSG_BUF *const p_msg = k_mailbox_take(p_sender_pids != NULL ? &p_sender_pids[n] : NULL, PID_ANY, MTYPE_ANY);
+		if (p_msg == NULL) {
+			break;
+		}
+		p_msgs[n] = p_msg;
+	}
+	if (n == 0) {
+		// Restarted once a message arrives
+		k_poll_receive(PID_ANY, MTYPE_ANY);
+	}
+	enable_irq();
+	return n;
+}
+
+/**
+ * @brief: send p_msg_env to pid and block until pid replies. If pid was blocked
+ *         in receive, and is at least as urgent as everything ready, the switch
+ *         goes straight to it.
+ * @return: the reply, or NULL if p_msg_env can't be sent to pid,
+ *          or pid exited without replying
+ */
+void *k_call(int pid, void *p_msg_env)
+{
+	disable_irq();
+	PCB *const p_pcb = &process[running];
+	if (p_pcb->m_calling) {
+		// Restarted by k_reply or k_exit_process
+		void *const p_reply = p_pcb->mp_reply;
+		p_pcb->mp_reply = NULL;
+		p_pcb->m_calling = 0;
+		enable_irq();
+		return p_reply;
+	}
+	if (pid == running || pid == PID_NULL || !validate_message(pid, p_msg_env)) {
+		enable_irq();
+		return NULL;
+	}
+
+	p_pcb->m_calling = pid + 1;
+	k_memory_hand_over(p_msg_env, running, pid);
+	if (k_mailbox_push(running, pid, p_msg_env)) {
+		k_direct_switch(pid);
+	}
+	// Restarted once pid replies
+	k_poll(BLOCKED_ON_REPLY);
+	enable_irq();
+	return NULL;
+}
+
+/**
+ * @brief: answer pid's call with p_msg_env. If pid is at least as urgent as
+ *         the running process, the switch goes straight back to it.
+ * @return: RTX_ERR if pid isn't blocked on a call to the running process
+ */
+int k_reply(int pid, void *p_msg_env)
+{
+	if (!validate_message(pid, p_msg_env)) {
+		return RTX_ERR;
+	}
+
+	disable_irq();
+	PCB *const p_caller = &process[pid];
+	if (p_caller->m_state != BLOCKED_ON_REPLY || p_caller->m_calling != running + 1) {
+		enable_irq();
+		return RTX_ERR;
+	}
+	MSG_BUF *const p_msg = p_msg_env;
+	p_msg->m_send_pid = running;
+	p_msg->m_recv_pid = pid;
+	k_memory_hand_over(p_msg, running, pid);
+	k_trace(TRACE_SEND, running, pid);
+
+	p_caller->mp_reply = p_msg;
+	p_caller->m_state = RDY;
+	k_trace(TRACE_STATE, pid, RDY);
+	if (k_ready_priority(pid) <= k_ready_priority(running)) {
+		k_direct_switch(pid);
+	} else {
+		k_enqueue_ready_process(pid);
+	}
+	enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * Program the timer for the next delayed message deadline. Must have IRQ lock.
+ */
+static void k_arm_delayed_messages_timer(void) {
+	U32 deadline;
+	if (tw_next_deadline(&g_delayed_msg_wheel, &deadline)) {
+		timer_set_deadline(deadline);
+	} else {
+		timer_clear_deadline();
+	}
+}
+
+// Timer callback of a delayed message, called by tw_advance with IRQ lock
+static void k_expire_delayed_message(timer_node_t *node) {
+	MSG_BUF *const msg = TIMER_MSG(node);
+	k_trace(TRACE_TIMER, msg->m_recv_pid, msg->m_send_pid);
+	k_send_message_helper(msg->m_send_pid, msg->m_recv_pid, msg);
+}
+
+// Periodic messages have timers of their own, see k_exit_process
+static bool is_message_to(const timer_node_t *node, int pid) {
+	return node->mpf_expire == &k_expire_delayed_message && TIMER_MSG(node)->m_recv_pid == pid;
+}
+
+int k_delayed_send(int receiver_id, void *p_msg_env, int delay) {
+	// A shared block can't be taken back by cancel_delayed_send
+	if (!validate_message(receiver_id, p_msg_env) || k_memory_is_shared(p_msg_env)) {
+		return RTX_ERR;
+	}
+	
+	// If the delay is zero, that means we do not delay, and we just send the message right away
+	if (delay == 0) {
+		return k_send_message(receiver_id, p_msg_env);
+	}
+	
+		MSG_BUF *const p_msg_envelope = p_msg_env;
+
+		assert(running != PID_NONE);
+    p_msg_envelope->m_send_pid = process[running].m_pid;
+    p_msg_envelope->m_recv_pid = receiver_id;
+
+	disable_irq();
+	k_memory_hand_over(p_msg_envelope, running, receiver_id);
+
+	timer_node_t *const timer = MSG_TIMER(p_msg_envelope);
+	timer->m_where = 0;  // request_memory_block doesn't clear static messages
+	timer->mpf_expire = &k_expire_delayed_message;
+	tw_add(&g_delayed_msg_wheel, timer, timer_now(), delay);
+	k_arm_delayed_messages_timer();
+	enable_irq();
+	
+		return RTX_OK;
+}
+
+/**
+ * @brief: the periodic message entry whose envelope is p_msg_env.
+ *         NULL finds a free entry. Must have IRQ lock.
+ */
+static PERIODIC_MSG *k_find_periodic_message(const void *p_msg_env) {
+	for (int i = 0; i < NUM_PERIODIC_MSGS; ++i) {
+		if (g_periodic_msgs[i].mp_msg == p_msg_env) {
+			return &g_periodic_msgs[i];
+		}
+	}
+	return NULL;
+}
+
+bool k_is_periodic_message(void *p_msg_env) {
+	return p_msg_env != NULL && k_find_periodic_message(p_msg_env) != NULL;
+}
+
+/**
+ * @brief: whether pid's reference to the heap block p_msg is still on its way,
+ *         in the delayed message wheel or a mailbox, which point at the block.
+ *         A shared block is queued through mail links, one in each receiver's mailbox.
+ */
+bool k_message_in_flight(void *p_msg, pid_t pid) {
+	if (!k_memory_is_shared(p_msg)) {
+		const timer_node_t *const timer = MSG_TIMER((MSG_BUF *)p_msg);
+		return k_memory_is_queued(p_msg) || (tw_pending(timer) && timer->mpf_expire == &k_expire_delayed_message);
+	}
+	for (void *p_entry = g_mailboxes[pid].mp_front; p_entry != NULL; p_entry = *(void **)p_entry) {
+		if (k_mail_entry_msg(p_entry) == p_msg) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// The receiver took it out of its mailbox, so the next period delivers it again
+static void k_periodic_message_received(void *p_msg_env) {
+	PERIODIC_MSG *const periodic = k_find_periodic_message(p_msg_env);
+	if (periodic != NULL) {
+		periodic->m_queued = false;
+	}
+}
+
+// Take msg out of pid's mailbox, keeping the order of the rest. Must have IRQ lock.
+static void k_mailbox_remove(pid_t pid, MSG_BUF *msg) {
+	void *p_prev = NULL;
+	for (void *p_entry = g_mailboxes[pid].mp_front; p_entry != NULL; p_entry = *(void **)p_entry) {
+		if (k_mail_entry_msg(p_entry) == msg) {
+			k_mailbox_unlink(pid, p_prev, p_entry);
+			return;
+		}
+		p_prev = p_entry;
+	}
+}
+
+// Timer callback of a periodic message, called by tw_advance with IRQ lock
+static void k_expire_periodic_message(timer_node_t *node) {
+	PERIODIC_MSG *const periodic = (PERIODIC_MSG *)node;
+	MSG_BUF *const msg = periodic->mp_msg;
+
+	// Count from this deadline rather than from now, so lateness doesn't add up
+	tw_add(&g_delayed_msg_wheel, node, node->m_expiry, periodic->m_period);
+	if (periodic->m_queued) {
+		// Not received since the last period, which it now also stands for
+		++msg->m_kdata[0];
+		return;
+	}
+	msg->m_kdata[0] = 1;
+	periodic->m_queued = true;
+	periodic->m_delivered = true;
+	k_trace(TRACE_TIMER, msg->m_recv_pid, msg->m_send_pid);
+	k_send_message_helper(msg->m_send_pid, msg->m_recv_pid, msg);
+}
+
+/**
+ * @brief: send p_msg_env to receiver_id every period ms, from period ms from now,
+ *         until the sender cancels it
+ * @return: RTX_ERR if the arguments are invalid or all NUM_PERIODIC_MSGS are in use
+ */
+int k_periodic_send(int receiver_id, void *p_msg_env, int period) {
+	if (!validate_message(receiver_id, p_msg_env) || k_memory_is_shared(p_msg_env) || period <= 0) {
+		return RTX_ERR;
+	}
+	MSG_BUF *const msg = p_msg_env;
+
+	disable_irq();
+	PERIODIC_MSG *const periodic = k_find_periodic_message(NULL);
+	if (periodic == NULL) {
+		enable_irq();
+		return RTX_ERR;
+	}
+	msg->m_send_pid = running;
+	msg->m_recv_pid = receiver_id;
+	k_memory_hand_over(msg, running, receiver_id);
+
+	periodic->mp_msg = msg;
+	periodic->m_period = period;
+	periodic->m_queued = false;
+	periodic->m_delivered = false;
+	periodic->m_timer.mpf_expire = &k_expire_periodic_message;
+	tw_add(&g_delayed_msg_wheel, &periodic->m_timer, timer_now(), period);
+	k_arm_delayed_messages_timer();
+	enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * @brief: the timer of p_msg_env, if it's a delayed message from the running
+ *         process that hasn't been delivered yet, or a periodic message from it.
+ *         Must have IRQ lock.
+ * @return: its timer, or NULL
+ */
+static timer_node_t *k_pending_delayed_send(void *p_msg_env) {
+	PERIODIC_MSG *const periodic = p_msg_env != NULL ? k_find_periodic_message(p_msg_env) : NULL;
+	if (periodic != NULL) {
+		return periodic->mp_msg->m_send_pid == running ? &periodic->m_timer : NULL;
+	}
+	if (!k_memory_is_block(p_msg_env)) {
+		return NULL;
+	}
+	MSG_BUF *const msg = p_msg_env;
+	timer_node_t *const timer = MSG_TIMER(msg);
+	if (!tw_pending(timer) || timer->mpf_expire != &k_expire_delayed_message || msg->m_send_pid != running) {
+		return NULL;
+	}
+	return timer;
+}
+
+/**
+ * @brief: take back an undelivered delayed message, which the sender owns again.
+ *         A periodic message stops, and is taken out of the receiver's mailbox.
+ * @return: RTX_ERR if it isn't one of the running process's pending delayed messages
+ */
+int k_cancel_delayed_send(void *p_msg_env) {
+	disable_irq();
+	timer_node_t *const timer = k_pending_delayed_send(p_msg_env);
+	if (timer == NULL) {
+		enable_irq();
+		return RTX_ERR;
+	}
+	tw_remove(&g_delayed_msg_wheel, timer);
+	k_arm_delayed_messages_timer();
+	PERIODIC_MSG *const periodic = k_find_periodic_message(p_msg_env);
+	if (periodic != NULL) {
+		if (periodic->m_queued) {
+			k_mailbox_remove(periodic->mp_msg->m_recv_pid, periodic->mp_msg);
+		}
+		periodic->mp_msg = NULL;
+	}
+	k_memory_set_owner(p_msg_env, running);
+	enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * @brief: deliver an undelivered delayed message delay ms from now instead.
+ *         A periodic message is next delivered delay ms from now, then every period.
+ * @return: RTX_ERR if it isn't one of the running process's pending delayed messages
+ */
+int k_reschedule_delayed_send(void *p_msg_env, int delay) {
+	disable_irq();
+	timer_node_t *const timer = k_pending_delayed_send(p_msg_env);
+	if (timer == NULL) {
+		enable_irq();
+		return RTX_ERR;
+	}
+	tw_remove(&g_delayed_msg_wheel, timer);
+	tw_add(&g_delayed_msg_wheel, timer, timer_now(), delay);
+	k_arm_delayed_messages_timer();
+	enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * Timer callback of a sleeping process, or of a blocked call's timeout,
+ * called by tw_advance with IRQ lock.
+ */
+static void k_expire_process_timer(timer_node_t *node) {
+	PCB *const p_pcb = (PCB *)((U8 *)node - offsetof(PCB, m_timer));
+	if (p_pcb->m_state != BLOCKED_ON_TIMER) {
+		// Even if what it waited for woke it first, its call hasn't returned yet,
+		// and it may not find it anymore
+		p_pcb->m_timed_out = true;
+		if (p_pcb->m_state == BLOCKED_ON_RESOURCE) {
+			bq_remove(&g_blocked_on_resource_queue[p_pcb->m_mem_pool], p_pcb->m_pid);
+		} else if (p_pcb->m_state != BLOCKED_ON_RECEIVE) {
+			return;
+		}
+	}
+	p_pcb->m_state = RDY;
+	k_trace(TRACE_STATE, p_pcb->m_pid, RDY);
+	k_enqueue_ready_process(p_pcb->m_pid);
+}
+
+// Start the running process's timer. Must have IRQ lock.
+static void k_start_process_timer(int ms) {
+	timer_node_t *const timer = &process[running].m_timer;
+	timer->mpf_expire = &k_expire_process_timer;
+	tw_add(&g_delayed_msg_wheel, timer, timer_now(), ms);
+	k_arm_delayed_messages_timer();
+}
+
+void k_poll_timeout(PROC_STATE_E which, int ms) {
+	assert(ms > 0);
+	disable_irq();
+	if (!tw_pending(&process[running].m_timer)) {
+		k_start_process_timer(ms);
+	}
+	k_poll(which);
+	enable_irq();
+}
+
+bool k_timeout_expired(void) {
+	return process[running].m_timed_out;
+}
+
+void k_end_timeout(void) {
+	disable_irq();
+	process[running].m_timed_out = false;
+	if (tw_remove(&g_delayed_msg_wheel, &process[running].m_timer)) {
+		k_arm_delayed_messages_timer();
+	}
+	enable_irq();
+}
+
+/**
+ * @brief: block the running process for ms milliseconds. Its timer is in its
+ *         PCB, so sleeping takes no memory block.
+ * @return: RTX_OK once it has slept, RTX_ERR if ms is negative or it's the null process
+ */
+int k_sleep(int ms) {
+	if (ms < 0 || running == PID_NULL) {
+		return RTX_ERR;
+	}
+	if (ms == 0) {
+		return RTX_OK;
+	}
+
+	disable_irq();
+	k_start_process_timer(ms);
+	k_poll(BLOCKED_ON_TIMER);
+	enable_irq();
+	return RTX_OK;
+}
+
+bool k_check_delayed_messages(void) {
+	disable_irq();
+	// Sends every message and wakes every sleeper that expired since the last call
+	const bool sent = tw_advance(&g_delayed_msg_wheel, timer_now()) > 0;
+	k_arm_delayed_messages_timer();
+	enable_irq();
+	return sent;
+}
+
+/**
+ * @brief: start a process on a stack from the stack pool
+ * @return: its pid, or RTX_ERR if the arguments are invalid or no pid or stack is free
+ */
+int k_create_process(void (*entry)(void), int priority, int stack_size) {
+	// Every stack from the pool is USR_SZ_STACK, so stack_size only places the guard
+	if (entry == NULL || priority < HIGHEST || priority > LOWEST ||
+			stack_size < MIN_SZ_STACK || stack_size > USR_SZ_STACK) {
+		return RTX_ERR;
+	}
+
+	disable_irq();
+	pid_t pid;
+	// The running process may have just exited, and still be on its stack
+	for (pid = MAX_PID + 1; pid < NUM_PROCS; ++pid) {
+		if (process[pid].m_state == UNUSED && pid != running) {
+			break;
+		}
+	}
+	U32 *const sp = pid < NUM_PROCS ? alloc_pool_stack(stack_size) : NULL;
+	if (sp == NULL) {
+		enable_irq();
+		return RTX_ERR;
+	}
+	k_init_process(pid, priority, entry, sp, stack_size);
+	k_trace(TRACE_STATE, pid, NEW);
+	enable_irq();
+
+	k_check_preemption();
+	return pid;
+}
+
+/**
+ * @brief: end the running process. Its mailbox, pending delayed messages and
+ *         memory blocks are freed now, and its pid and stack once PendSV
+ *         switches away from it.
+ * @return: only returns, with RTX_ERR, for the null process
+ */
+int k_exit_process(void) {
+	assert(running != PID_NONE);
+	if (running == PID_NULL) {
+		return RTX_ERR;
+	}
+
+	disable_irq();
+	const pid_t pid = running;
+	while (g_mailboxes[pid].mp_front != NULL) {
+		k_mailbox_unlink(pid, NULL, g_mailboxes[pid].mp_front);
+	}
+	tw_remove_if(&g_delayed_msg_wheel, &is_message_to, pid);
+	for (int i = 0; i < NUM_PERIODIC_MSGS; ++i) {
+		PERIODIC_MSG *const periodic = &g_periodic_msgs[i];
+		MSG_BUF *const msg = periodic->mp_msg;
+		if (msg == NULL || (msg->m_recv_pid != pid && msg->m_send_pid != pid)) {
+			continue;
+		}
+		tw_remove(&g_delayed_msg_wheel, &periodic->m_timer);
+		periodic->mp_msg = NULL;
+		// Its sender is gone, so the receiver keeps the envelope as an ordinary block,
+		// queued or not. One it never got goes back to the sender to be released.
+		if (msg->m_recv_pid != pid && !periodic->m_delivered) {
+			k_memory_set_owner(msg, pid);
+		}
+	}
+	k_arm_delayed_messages_timer();
+	// Every block in its mailbox and in the delayed message wheel was handed to it
+	k_memory_release_owned(pid);
+	// Nobody will reply to its callers, their calls return NULL
+	for (int i = 0; i < NUM_PROCS; ++i) {
+		if (process[i].m_state == BLOCKED_ON_REPLY && process[i].m_calling == pid + 1) {
+			process[i].m_state = RDY;
+			k_trace(TRACE_STATE, i, RDY);
+			k_enqueue_ready_process(i);
+		}
+	}
+
+	process[pid].m_state = UNUSED;
+	k_trace(TRACE_STATE, pid, UNUSED);
+	k_request_reschedule();
+	enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * @brief: charge the cycles since the last call to whoever was running, and
+ *         start charging pid. Must have IRQ lock.
+ * TIM1 counts up in core clock cycles. The SysTick counter of USE_SYSTICK
+ * counts down and wraps every 24 bits, so it doesn't work here.
+ * @return: the pid that was being charged
+ */
+static pid_t k_account(pid_t pid) {
+	const U32 now = get_cycle_count24();
+	const pid_t prev = g_account_pid;
+	if (prev != PID_NONE) {
+		g_cpu_cycles[prev] += now - g_account_since;
+	}
+	g_account_since = now;
+	g_account_pid = pid;
+	return prev;
+}
+
+pid_t k_account_isr_enter(pid_t iproc) {
+	disable_irq();
+	const pid_t prev = k_account(iproc);
+	enable_irq();
+	return prev;
+}
+
+void k_account_isr_exit(pid_t prev) {
+	disable_irq();
+	k_account(prev);
+	enable_irq();
+}
+
+int k_get_cpu_usage(int pid, PROC_CPU *p_usage) {
+	if (pid < PID_NULL || pid >= NUM_PROCS || p_usage == NULL || process[pid].m_state == UNUSED) {
+		return RTX_ERR;
+	}
+	disable_irq();
+	// Bring the caller's own count up to date
+	k_account(g_account_pid);
+	p_usage->m_cycles = g_cpu_cycles[pid];
+	p_usage->m_switches = g_cpu_switches[pid];
+	p_usage->m_state = process[pid].m_state;
+	p_usage->m_priority = process[pid].m_priority;
+	enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * @brief: the high-water mark of pid's stack, from the words still STACK_PAINT
+ *         at the bottom. A process could write STACK_PAINT itself, so this
+ *         may count a few bytes short.
+ * @return: bytes, or RTX_ERR if pid has no stack, like the i-processes
+ */
+int k_get_stack_usage(int pid) {
+	if (pid < PID_NULL || pid >= NUM_PROCS || process[pid].m_state == UNUSED || process[pid].m_stack_size == 0) {
+		return RTX_ERR;
+	}
+	// The guard isn't readable while pid runs, and it's never used anyway
+	const U32 *p_word = process[pid].mp_stack_limit + STACK_GUARD_SIZE / 4;
+	const U32 *const p_top = process[pid].mp_stack_limit + process[pid].m_stack_size / 4;
+	while (p_word != p_top && *p_word == STACK_PAINT) {
+		++p_word;
+	}
+	return (p_top - p_word) * sizeof(U32);
+}
+
 // Allow recursive IRQ disable
 
 static int irq_lock_count = 0;
@@ -510,38 +1514,50 @@ void enable_irq(void) {
 void disable_irq(void) {
 	__disable_irq();
 	++irq_lock_count;
-}
-
-#ifdef _DEBUG_HOTKEYS
-void k_print_blocked_on_receive_queue(void) {
-	printf("Blocked on receive processes:\n");
-	for (int prio = 0; prio < NULL_PRIO; ++prio) {
-		printf("  Priority %d:", prio);
-		for (int i = 0; i <= PID_CRT; ++i) {
-			if (prio == process[i].m_priority) {
-				if (BLOCKED_ON_RECEIVE == process[i].m_state) {
-					printf(" %d", process[i].m_pid);
-				}
-			}
-		}
-		printf("\n");
-	}
-}
-void k_print_blocked_on_memory_queue(void) {
-	printf("Blocked on memory processes:\n");
-	print_priority_queue(g_blocked_on_resource_queue);
-}
-
-
-
-void k_print_ready_queue(void) {
-	printf("Ready processes:\n");
-	print_priority_queue(g_ready_queue);
-	// READY PROCESSES
-	// <space><space>PID <pid>
-	// print format: processes or (hi - lo):
-	// p
-}
-
+}
+
+#ifdef _DEBUG_HOTKEYS
+void k_print_blocked_on_receive_queue(void) {
+	printf("Blocked on receive processes:\n");
+	for (int prio = 0; prio < NULL_PRIO; ++prio) {
+		printf("  Priority %d:", prio);
+		for (int i = 0; i < NUM_PROCS; ++i) {
+			if (prio == process[i].m_priority) {
+				if (BLOCKED_ON_RECEIVE == process[i].m_state) {
+					printf(" %d", process[i].m_pid);
+				}
+			}
+		}
+		printf("\n");
+	}
+}
+void k_print_blocked_on_memory_queue(void) {
+	for (int pool = 0; pool < NUM_MEM_POOLS; ++pool) {
+		printf("Blocked on memory pool %d processes:\n", pool);
+		print_bitmap_queue(&g_blocked_on_resource_queue[pool]);
+	}
+}
+
+
+
+void k_print_ready_queue(void) {
+	printf("Ready processes:\n");
+	print_bitmap_queue(&g_ready_queue);
+	// READY PROCESSES
+	// <space><space>PID <pid>
+	// print format: processes or (hi - lo):
+	// p
+}
+
+void k_print_stack_usage(void) {
+	printf("Stack usage:\n");
+	for (int pid = 0; pid < NUM_PROCS; ++pid) {
+		const int used = k_get_stack_usage(pid);
+		if (used != RTX_ERR) {
+			printf("  PID %d: %d of %d bytes\n", pid, used, process[pid].m_stack_size);
+		}
+	}
+}
+
 #endif
-
+
@@ -10,6 +10,7 @@
 #ifndef K_PROCESS_H_
 #define K_PROCESS_H_
 
+#include <stdbool.h>
 #include "common.h"
 #include "k_rtx.h"
 
@@ -18,8 +19,7 @@
 /* ----- Definitions ----- */
 
 #define INITIAL_xPSR 0x01000000        /* user process initial xPSR value */
-
-#define NUM_PROCS (MAX_PID + 1)
+#define PID_NONE (-1)                  /* no process, e.g. nobody running or waiting */
 
 typedef int pid_t;
 
@@ -29,25 +29,44 @@ void process_init(void);               /* initialize all procs in the system */
 int k_release_processor(void);           /* kernel release_processor function */
 
 extern U32 *alloc_stack(U32 size_b);   /* allocate stack for a process */
-extern void __rte(void);               /* pop exception stack frame */
 extern void set_test_procs(void);      /* test process initial set up */
 
 // recursive IRQ disabling
 void enable_irq(void);
 void disable_irq(void);
 
-// Preempt the current process if needed.
-// Does nothing if already preempted.
+// Preempt the current process if needed, once no other exception is active.
+// Only pends PendSV, so it is safe to call from ISRs.
 void k_check_preemption(void);
 void k_check_preemption_eager(void);
+U32 *k_pendsv_handler(U32 *sp);
+void k_svc_return(U32 ret, U32 *frame);
 void k_send_message_helper(int sender_pid, int receiver_pid, void *p_msg);
 // Suspend the process until an event is triggered.
-// which is one of: RDY, BLOCKED_ON_RESOURCE, or BLOCKED_ON_RECEIVE
+// which is one of: RDY, BLOCKED_ON_RESOURCE, BLOCKED_ON_RECEIVE, BLOCKED_ON_TIMER
+// or BLOCKED_ON_REPLY
+// The switch happens when the system call returns, and blocked calls are restarted,
+// so the caller should return right away.
 void k_poll(PROC_STATE_E which);
-// Unblock processes receiving delayed messages.
+// Same as k_poll, but also wake up after ms milliseconds, ms > 0.
+// The timeout starts on the first call, a restarted call keeps its deadline.
+void k_poll_timeout(PROC_STATE_E which, int ms);
+// Whether the timeout of the running process's blocked call expired
+bool k_timeout_expired(void);
+// Stop the running process's timeout, once its call returns however it ends
+void k_end_timeout(void);
+// Unblock processes receiving delayed messages, and sleeping processes.
 // Move the messages to the appropriate queue.
-void k_check_delayed_messages(void);
+// Returns whether any message was sent or any process woke up.
+bool k_check_delayed_messages(void);
 int k_internal_get_process_priority(int pid);
+pid_t k_running_pid(void);
+// Hand a released block to a process blocked on memory from pool. Returns its pid, or -1.
+pid_t k_memory_handoff(int pool, void *p_mem_blk);
+// The pool the running process blocks on, before it polls BLOCKED_ON_RESOURCE
+void k_memory_wait_for(int pool);
+// The block handed to the running process while it was blocked, or NULL
+void *k_memory_take_handoff(void);
 
 // System calls
 int k_set_process_priority(int process_id, int priority);
@@ -55,15 +74,42 @@ int k_get_process_priority(int process_id);
 
 /*Inter Process Communication*/
 int k_send_message(int receiver_pid, void *p_msg_env);
+int k_multicast_message(U32 pid_mask, void *p_msg_env);
 void *k_receive_message(int *sender_id);
+void *k_receive_message_timeout(int *sender_id, int ms);
+void *k_receive_message_match(int *sender_id, U32 pid_mask, int mtype);
+void *k_non_blocking_receive_message(int *sender_id);
+int k_receive_messages(void *p_msgs[], int p_sender_pids[], int max);
+void *k_call(int pid, void *p_msg_env);
+int k_reply(int pid, void *p_msg_env);
 
 int k_delayed_send(int sender_pid, void *p_msg_env, int delay);
+int k_cancel_delayed_send(void *p_msg_env);
+int k_reschedule_delayed_send(void *p_msg_env, int delay);
+int k_periodic_send(int receiver_pid, void *p_msg_env, int period);
+int k_sleep(int ms);
+// Whether p_msg_env is the envelope of a running periodic message
+bool k_is_periodic_message(void *p_msg_env);
+// Whether pid's reference to a heap block is still waiting to be delivered or received
+bool k_message_in_flight(void *p_msg, pid_t pid);
+
+/* Process creation and exit */
+int k_create_process(void (*entry)(void), int priority, int stack_size);
+int k_exit_process(void);
+
+/* CPU accounting */
+int k_get_cpu_usage(int pid, PROC_CPU *p_usage);
+int k_get_stack_usage(int pid);
+// Charge the cycles until k_account_isr_exit to iproc. Returns who to charge after.
+pid_t k_account_isr_enter(pid_t iproc);
+void k_account_isr_exit(pid_t prev);
 
 
 #ifdef _DEBUG_HOTKEYS
 void k_print_blocked_on_receive_queue(void);
 void k_print_blocked_on_memory_queue(void);
 void k_print_ready_queue(void);
+void k_print_stack_usage(void);
 #endif
 
 
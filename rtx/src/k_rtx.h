@@ -10,6 +10,8 @@
 #ifndef K_RTX_H_
 #define K_RTX_H_
 
+#include "timer_wheel.h"
+
 #include "allow_k.h"
 
 /*----- Definitations -----*/
@@ -18,16 +20,31 @@
 #define RTX_OK  0
 
 #define NULL 0
-#define NUM_MEM_BLOCKS 30
 #define MEM_BLOCK_SIZE 128
+/* The default pool takes the rest of the RAM, see memory_init */
+#define NUM_SMALL_MEM_BLOCKS 16
+#define NUM_LARGE_MEM_BLOCKS 4
+/* More blocks than fit in 64 KB, IRAM1 and the AHB SRAM together */
+#define MAX_MEM_BLOCKS (0x10000 / MEM_BLOCK_SIZE)
+
+/* Memory pools, by block size. request_memory_block is from MEM_POOL_DEFAULT. */
+#define MEM_POOL_SMALL   0
+#define MEM_POOL_DEFAULT 1
+#ifdef HEAP_IN_AHB_SRAM
+/* More MEM_BLOCK_SIZE blocks, in the local SRAM above the image. A request
+   falls through to them once MEM_POOL_DEFAULT, in the AHB SRAM, runs out. */
+#define MEM_POOL_DEFAULT_LOCAL 2
+#define MEM_POOL_LARGE   3
+#define NUM_MEM_POOLS    4
+#else
+#define MEM_POOL_LARGE   2
+#define NUM_MEM_POOLS    3
+#endif
 
 /*----- Types -----*/
 typedef unsigned char U8;
 typedef unsigned int U32;
 
-/* process states */
-typedef enum {NEW = 0, RDY, RUN, BLOCKED_ON_RESOURCE, BLOCKED_ON_RECEIVE, NUM_PROC_STATES} PROC_STATE_E;
-
 /*
   PCB data structure definition.
   You may want to add your own member variables
@@ -40,6 +57,16 @@ typedef struct pcb
 	U32 m_pid;		/* process id */
 	PROC_STATE_E m_state;   /* state of the process */
 	int m_priority;         /* current priority */
+	void *mp_handoff;       /* memory block released to it while BLOCKED_ON_RESOURCE */
+	U32 *mp_stack_limit;    /* bottom of its stack, STACK_GUARD_SIZE aligned, where the guard is */
+	U32 m_stack_size;       /* in bytes, from mp_stack_limit up */
+	U8 m_mem_pool;          /* the MEM_POOL_* it waits on while BLOCKED_ON_RESOURCE */
+	timer_node_t m_timer;   /* pending while it sleeps, or blocks with a timeout */
+	bool m_timed_out;       /* the timeout of its blocked call expired, see k_end_timeout */
+	void *mp_reply;         /* reply handed to it while BLOCKED_ON_REPLY */
+	U8 m_calling;           /* pid + 1 of the process its call waits on, or 0 */
+	U32 m_recv_mask;        /* senders whose messages wake it while BLOCKED_ON_RECEIVE */
+	int m_recv_mtype;       /* and the type, or MTYPE_ANY */
 } PCB;
 
 #include "disallow_k.h"
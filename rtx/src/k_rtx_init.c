@@ -5,28 +5,32 @@
  * @date:   2014/01/17
  */
 
+#include <LPC17xx.h>
 #include "k_rtx_init.h"
-#include "uart_polling.h"
+#include "uart_polling.h"
 #include "uart.h"
 #include "k_memory.h"
-#include "k_process.h"
-#include "k_cycle_count.h"
+#include "k_process.h"
+#include "k_cycle_count.h"
 #include "timer.h"
 
 #include "allow_k.h"
 
 void k_rtx_init(void)
 {
-	disable_irq();
+	disable_irq();
+	/* PendSV does the context switches, after every other exception */
+	NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
 	k_cycle_count_init();
 	uart_irq_init(0);   // uart0, interrupt-driven 
-	uart1_init();       // uart1, polling
-	timer_init(0);
+	uart1_init();       // uart1, polling
+	timer_init(0);
 	memory_init();
 	process_init();
 	enable_irq();
-	
-	uart1_put_string("RTX is starting\n\r");
-	/* start the first process */
+	
+	uart1_put_string("RTX is starting\n\r");
+	k_memory_report();
+	/* start the first process, once this SVC returns */
 	k_release_processor();
 }
@@ -0,0 +1,44 @@
+/**
+ * @file:   k_svc.c
+ * @brief:  System call dispatch table, indexed by SVC number
+ */
+
+#include "k_svc.h"
+#include "k_rtx_init.h"
+#include "k_memory.h"
+#include "k_process.h"
+
+#include "allow_k.h"
+
+/* In flash, so a process can't redirect a system call */
+const svc_fn_t g_svc_table[SVC_NUM_CALLS] = {
+	/* Never block, R0 is stored straight back to the caller */
+	[SVC_GET_PROCESS_PRIORITY] = (svc_fn_t)k_get_process_priority,
+	[SVC_SET_PROCESS_PRIORITY] = (svc_fn_t)k_set_process_priority,
+	[SVC_RELEASE_PROCESSOR]    = (svc_fn_t)k_release_processor,
+	[SVC_RELEASE_MEMORY_BLOCK] = (svc_fn_t)k_release_memory_block,
+	[SVC_SEND_MESSAGE]         = (svc_fn_t)k_send_message,
+	[SVC_DELAYED_SEND]         = (svc_fn_t)k_delayed_send,
+	[SVC_CANCEL_DELAYED_SEND]  = (svc_fn_t)k_cancel_delayed_send,
+	[SVC_RESCHEDULE_DELAYED_SEND] = (svc_fn_t)k_reschedule_delayed_send,
+	[SVC_PERIODIC_SEND]        = (svc_fn_t)k_periodic_send,
+	[SVC_CREATE_PROCESS]       = (svc_fn_t)k_create_process,
+	[SVC_EXIT_PROCESS]         = (svc_fn_t)k_exit_process,
+	[SVC_GET_CPU_USAGE]        = (svc_fn_t)k_get_cpu_usage,
+	[SVC_RTX_INIT]             = (svc_fn_t)k_rtx_init,
+	[SVC_NON_BLOCKING_RECEIVE_MESSAGE] = (svc_fn_t)k_non_blocking_receive_message,
+	[SVC_REPLY]                = (svc_fn_t)k_reply,
+	[SVC_MULTICAST_MESSAGE]    = (svc_fn_t)k_multicast_message,
+	[SVC_GET_STACK_USAGE]      = (svc_fn_t)k_get_stack_usage,
+
+	/* May block, returns through k_svc_return */
+	[SVC_REQUEST_MEMORY_BLOCK] = (svc_fn_t)k_request_memory_block,
+	[SVC_RECEIVE_MESSAGE]      = (svc_fn_t)k_receive_message,
+	[SVC_SLEEP]                = (svc_fn_t)k_sleep,
+	[SVC_REQUEST_MEMORY_BLOCK_TIMEOUT] = (svc_fn_t)k_request_memory_block_timeout,
+	[SVC_RECEIVE_MESSAGE_TIMEOUT] = (svc_fn_t)k_receive_message_timeout,
+	[SVC_RECEIVE_MESSAGE_MATCH] = (svc_fn_t)k_receive_message_match,
+	[SVC_RECEIVE_MESSAGES]     = (svc_fn_t)k_receive_messages,
+	[SVC_CALL]                 = (svc_fn_t)k_call,
+	[SVC_REQUEST_MEMORY_BLOCK_SIZED] = (svc_fn_t)k_request_memory_block_sized,
+};
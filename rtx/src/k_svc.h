@@ -0,0 +1,17 @@
+/**
+ * @file:   k_svc.h
+ * @brief:  System call dispatch table, indexed by SVC number
+ */
+
+#ifndef K_SVC_H_
+#define K_SVC_H_
+
+#include "k_rtx.h"
+
+/* R0-R3 of the caller in, R0 out. Calls with fewer arguments ignore the rest. */
+typedef U32 (*svc_fn_t)(U32, U32, U32, U32);
+
+/* Read by SVC_Handler in HAL.c */
+extern const svc_fn_t g_svc_table[SVC_NUM_CALLS];
+
+#endif /* ! K_SVC_H_ */
@@ -0,0 +1,49 @@
+/**
+ * @file:   k_trace.c
+ * @brief:  Ring buffer of kernel events
+ */
+
+#include "k_trace.h"
+#include "uart_polling.h"
+
+K_TRACE_EVENT g_trace[K_TRACE_SIZE];
+U32 g_trace_head = 0;
+
+static void put_hex(U32 value, int digits)
+{
+	static const char hex[] = "0123456789abcdef";
+	while (digits-- > 0) {
+		uart1_put_char(hex[(value >> (4 * digits)) & 0xF]);
+	}
+}
+
+/**
+ * Format, one line per event:
+ *   TRACE <events recorded, including overwritten ones> <core clock in Hz>
+ *   <time> <event> <pid> <arg>
+ *   END
+ * all in hex.
+ */
+void k_trace_dump(void)
+{
+	const U32 head = g_trace_head;
+	const U32 count = head < K_TRACE_SIZE ? head : K_TRACE_SIZE;
+
+	uart1_put_string("\r\nTRACE ");
+	put_hex(head, 8);
+	uart1_put_char(' ');
+	put_hex(__CORE_CLK, 8);
+	uart1_put_string("\r\n");
+	for (U32 i = head - count; i != head; ++i) {
+		const K_TRACE_EVENT *const p = &g_trace[i & (K_TRACE_SIZE - 1)];
+		put_hex(p->m_time, 8);
+		uart1_put_char(' ');
+		put_hex(p->m_event, 2);
+		uart1_put_char(' ');
+		put_hex(p->m_pid, 2);
+		uart1_put_char(' ');
+		put_hex(p->m_arg, 4);
+		uart1_put_string("\r\n");
+	}
+	uart1_put_string("END\r\n");
+}
@@ -0,0 +1,58 @@
+/**
+ * @file:   k_trace.h
+ * @brief:  Ring buffer of kernel events, timestamped with TIM1.
+ *          Dumped to UART1 with HOTKEY_TRACE_DUMP, and decoded on the host
+ *          by rtx/tools/trace_decode.py.
+ */
+
+#ifndef K_TRACE_H_
+#define K_TRACE_H_
+
+#include <LPC17xx.h>
+#include "k_rtx.h"
+#include "k_cycle_count.h"
+
+/* Events. The comments say what pid and arg are. */
+#define TRACE_SWITCH 1   /* pid starts running, arg is the old pid */
+#define TRACE_STATE  2   /* pid's state changes to arg, a PROC_STATE_E */
+#define TRACE_SEND   3   /* pid sends a message to arg */
+#define TRACE_RECV   4   /* pid receives a message from arg */
+#define TRACE_ALLOC  5   /* pid gets memory block number arg */
+#define TRACE_FREE   6   /* pid frees memory block number arg */
+#define TRACE_TIMER  7   /* a delayed message to pid expires, arg is the sender */
+
+/* A power of two, so the index is a mask */
+#define K_TRACE_SIZE 128
+
+typedef struct k_trace_event {
+	U32 m_time;     /* TIM1 count, in core clock cycles */
+	U8 m_event;     /* TRACE_* */
+	U8 m_pid;
+	unsigned short m_arg;
+} K_TRACE_EVENT;
+
+extern K_TRACE_EVENT g_trace[K_TRACE_SIZE];
+extern U32 g_trace_head;  /* number of events recorded so far */
+
+#ifdef K_TRACE
+/* A few cycles, so tracing can stay on. Safe from ISRs. */
+static inline void k_trace(U8 event, int pid, int arg)
+{
+	const U32 primask = __get_PRIMASK();
+	__disable_irq();
+	K_TRACE_EVENT *const p = &g_trace[g_trace_head++ & (K_TRACE_SIZE - 1)];
+	// With the slot, so an ISR can't take a later one with an earlier time
+	p->m_time = get_cycle_count24();
+	__set_PRIMASK(primask);
+	p->m_event = event;
+	p->m_pid = pid;
+	p->m_arg = arg;
+}
+#else
+#define k_trace(event, pid, arg) ((void)0)
+#endif
+
+/* Write the trace to UART1, oldest event first, with polling */
+void k_trace_dump(void);
+
+#endif /* ! K_TRACE_H_ */
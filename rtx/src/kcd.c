@@ -2,7 +2,7 @@
 #include <assert.h>
 #include "k_process.h"
 #include "common.h"
-#include "message_queue.h"
+#include "message_queue.h"
 #include "printf.h"
 
 #ifdef KCD_TEST
@@ -16,10 +16,23 @@ void send_message(int pid, MSG_BUF* msg) {
 	printf("to pid %d: %s\n", pid, msg->mtext);
 }
 
+int multicast_message(unsigned int pid_mask, MSG_BUF* msg) {
+	for (int pid = 0; pid < NUM_PROCS; ++pid) {
+		if (pid_mask & PID_BIT(pid)) {
+			send_message(pid, msg);
+		}
+	}
+	return RTX_OK;
+}
+
+int get_process_priority(int pid) {
+	return 0;
+}
+
 #else
 
-#include <LPC17xx.h>
-#include "uart_polling.h"
+#include <LPC17xx.h>
+#include "uart_polling.h"
 #include "uart.h"
 #include "rtx.h"
 #include "kcd.h"
@@ -39,24 +52,32 @@ static void kcd_process_command_registration(MSG_BUF* message) {
 
 static void kcd_process_keyboard_input(MSG_BUF* message) {
 	char *text = message->mtext;
-	int sent_to_mask = 0;
-	assert(NUM_PROCS <= 8 * sizeof(int));
-	for (MSG_BUF *cur = entries; cur; cur = cur->mp_next) {
-		if (strncmp(text, cur->mtext, strlen(cur->mtext)) == 0) {
-			const int pid = cur->m_send_pid;
-			const int pid_mask = 1 << pid;
-			if (sent_to_mask & pid_mask) {
-				continue;
-			}
-			sent_to_mask |= pid_mask;
-			MSG_BUF *const block = request_memory_block();
-			memcpy(block, message, 128);
-			send_message(pid, block);
+	unsigned int sent_to_mask = 0;
+	assert(NUM_PROCS <= 8 * sizeof(sent_to_mask));
+	for (MSG_BUF **p_cur = &entries; *p_cur;) {
+		MSG_BUF *const cur = *p_cur;
+		// Forget the commands of processes that have exited
+		if (get_process_priority(cur->m_send_pid) == RTX_ERR) {
+			*p_cur = cur->mp_next;
+			release_memory_block(cur);
+			continue;
+		}
+		if (strncmp(text, cur->mtext, strlen(cur->mtext)) == 0) {
+			sent_to_mask |= PID_BIT(cur->m_send_pid);
+		}
+		p_cur = (MSG_BUF **)&cur->mp_next;
+	}
+	if (sent_to_mask) {
+		// One copy, however many handlers share it
+		MSG_BUF *const block = request_memory_block();
+		memcpy(block, message, 128);
+		if (multicast_message(sent_to_mask, block) != RTX_OK) {
+			release_memory_block(block);
 		}
 	}
 }
-
-static char msg_buf[128];
+
+static char msg_buf[128];
 static MSG_BUF *msg = (MSG_BUF *) msg_buf;
 static int cmd_len = 0;
 // Call uart_iproc_getc until it returns NO_CHAR
@@ -70,8 +91,8 @@ static void kcd_handle_keyboard_input(void) {
 				msg->mtext[cmd_len] = '\0';
 				kcd_process_keyboard_input(msg);
 				cmd_len = 0;
-				break;
-			case NO_CHAR:
+				break;
+			case NO_CHAR:
 				return;
 			default:
 				if (cmd_len < MTEXT_MAXLEN) {
@@ -116,4 +137,4 @@ void proc_kcd(void) {
 		
     release_memory_block(message);
 	}
-}
+}
@@ -2,7 +2,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include "common.h"
+#include "common.h"
 #include "timer.h"
 #include "message_queue.h"
 
@@ -28,10 +28,11 @@ MSG_BUF *dequeue_message(MSG_BUF** msg_queue) {
 
     // TODO: Jobair: the test you see at the end of the file will probably break,
     // you may want to consult me (Kelvin)
-    int current_time = g_timer_count;
+    const U32 current_time = g_timer_count;
 
+    // Compare the difference, so the clock can wrap around
     MSG_BUF* msg_to_dequeue = *msg_queue;
-    if (msg_to_dequeue->m_kdata[0] > current_time) {
+    if ((int)(msg_to_dequeue->m_kdata[0] - current_time) > 0) {
         return NULL;
     }
 
@@ -41,13 +42,13 @@ MSG_BUF *dequeue_message(MSG_BUF** msg_queue) {
 }
 
 // we need to do something with delay
-void enqueue_message(MSG_BUF* msg, MSG_BUF** msg_queue) {
-	while (!(is_queue_empty(msg_queue) ||
-					(*msg_queue)->m_kdata[0] > msg->m_kdata[0])) {
-		msg_queue = (MSG_BUF **) & (*msg_queue)->mp_next;
-	}
-	msg->mp_next = *msg_queue;
-	*msg_queue = msg;
+void enqueue_message(MSG_BUF* msg, MSG_BUF** msg_queue) {
+	while (!(is_queue_empty(msg_queue) ||
+					(*msg_queue)->m_kdata[0] > msg->m_kdata[0])) {
+		msg_queue = (MSG_BUF **) & (*msg_queue)->mp_next;
+	}
+	msg->mp_next = *msg_queue;
+	*msg_queue = msg;
 	return;
 }
 
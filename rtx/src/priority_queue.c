@@ -27,22 +27,22 @@ pid_t peek_process_front(void* pq, int priority) {
     return LL_FRONT(priority_queue[priority]);
 }   
 
-pid_t peek_front(void* pq, int *prio) {
+pid_t peek_front(void* pq, int *prio) {
 		*prio = NUM_PRIORITIES;
-    pid_pq priority_queue = (pid_pq)pq;
-	
-		int hiprio;
-		LL_FOREACH(hiprio, priority_queue[HIGHEST]) {
-				if (hiprio == PID_KCD || hiprio == PID_CRT) {
-					  *prio = -1;
-						return hiprio;
-				}
-		}
+    pid_pq priority_queue = (pid_pq)pq;
+	
+		int hiprio;
+		LL_FOREACH(hiprio, priority_queue[HIGHEST]) {
+				if (hiprio == PID_KCD || hiprio == PID_CRT) {
+					  *prio = -1;
+						return hiprio;
+				}
+		}
 	
     for (int i = 0; i < NUM_PRIORITIES; i++) {
         if (LL_SIZE(priority_queue[i]) > 0) {
-            int pid = LL_FRONT(priority_queue[i]);
-					  *prio = k_internal_get_process_priority(pid);
+            int pid = LL_FRONT(priority_queue[i]);
+					  *prio = k_internal_get_process_priority(pid);
 					  return pid;
         }
     }
@@ -50,7 +50,7 @@ pid_t peek_front(void* pq, int *prio) {
 }  
 
 pid_t pop_first_process(void* pq) {
-    pid_pq priority_queue = (pid_pq)pq;
+    pid_pq priority_queue = (pid_pq)pq;
 	int prio;
 	int pid = peek_front(pq, &prio);
 	if (prio == -1) {
@@ -1,64 +1,88 @@
-/* @brief: rtx.h User API prototype, this is only an example
- * @author: Yiqing Huang
- * @date: 2016/02/24
- */
-#ifndef RTX_H_
-#define RTX_H_
-
-/*----- Includes -----*/
-#include "common.h"
-
-#include "allow_k.h"
-
-/* ----- Definitations ----- */
-
-/* ----- Types ----- */
-
-/* ----- RTX User API ----- */
-#define __SVC_0  __svc_indirect(0)
-
-/* RTX initialization */
-extern void k_rtx_init(void);
-#define rtx_init() _rtx_init((U32)k_rtx_init)
-extern void __SVC_0 _rtx_init(U32 p_func);
-
-/* Processor Management */
-extern int k_release_processor(void);
-#define release_processor() _release_processor((U32)k_release_processor)
-extern int __SVC_0 _release_processor(U32 p_func);
-
-extern int k_get_process_priority(int pid);
-#define get_process_priority(pid) _get_process_priority((U32)k_get_process_priority, pid)
-extern int _get_process_priority(U32 p_func, int pid) __SVC_0;
-/* __SVC_0 can also be put at the end of the function declaration */
-
-extern int k_set_process_priority(int pid, int prio);
-#define set_process_priority(pid, prio) _set_process_priority((U32)k_set_process_priority, pid, prio)
-extern int _set_process_priority(U32 p_func, int pid, int prio) __SVC_0;
-
-/* Memory Management */
-extern void *k_request_memory_block(void);
-#define request_memory_block() _request_memory_block((U32)k_request_memory_block)
-extern void *_request_memory_block(U32 p_func) __SVC_0;
-
-
-extern int k_release_memory_block(void *);
-#define release_memory_block(p_mem_blk) _release_memory_block((U32)k_release_memory_block, p_mem_blk)
-extern int _release_memory_block(U32 p_func, void *p_mem_blk) __SVC_0;
-
-/* IPC Management */
-extern int k_send_message(int pid, void *p_msg);
-#define send_message(pid, p_msg) _send_message((U32)k_send_message, pid, p_msg)
-extern int _send_message(U32 p_func, int pid, void *p_msg) __SVC_0;
-
-extern void *k_receive_message(int *p_pid);
-#define receive_message(p_pid) _receive_message((U32)k_receive_message, p_pid)
-extern void *_receive_message(U32 p_func, void *p_pid) __SVC_0;
-
-/* Timing Service */
-extern int k_delayed_send(int pid, void *p_msg, int delay);
-#define delayed_send(pid, p_msg, delay) _delayed_send((U32)k_delayed_send, pid, p_msg, delay)
-extern int _delayed_send(U32 p_func, int pid, void *p_msg, int delay) __SVC_0;  
-
-#include "disallow_k.h"
-#endif /* !RTX_H_ */
+/* @brief: rtx.h User API prototype, this is only an example
+ * @author: Yiqing Huang
+ * @date: 2016/02/24
+ */
+#ifndef RTX_H_
+#define RTX_H_
+
+/*----- Includes -----*/
+#include "common.h"
+
+/* ----- Definitations ----- */
+
+/* ----- Types ----- */
+
+/* ----- RTX User API ----- */
+/* Each call is an SVC with its own number, see the SVC_* numbers in common.h */
+
+/* RTX initialization */
+extern void __svc(SVC_RTX_INIT) rtx_init(void);
+
+/* Processor Management */
+extern int __svc(SVC_RELEASE_PROCESSOR) release_processor(void);
+extern int __svc(SVC_GET_PROCESS_PRIORITY) get_process_priority(int pid);
+extern int __svc(SVC_SET_PROCESS_PRIORITY) set_process_priority(int pid, int prio);
+
+/* Process Management. A process also exits by returning from its entry point. */
+/* stack_size is from MIN_SZ_STACK to USR_SZ_STACK. Every process gets a whole
+   USR_SZ_STACK stack, so a smaller one saves no memory. It only moves the guard
+   up, so an overflow past stack_size is caught. */
+extern int __svc(SVC_CREATE_PROCESS) create_process(void (*entry)(void), int prio, int stack_size);
+extern int __svc(SVC_EXIT_PROCESS) exit_process(void);
+extern int __svc(SVC_GET_CPU_USAGE) get_cpu_usage(int pid, PROC_CPU *p_usage);
+/* The most bytes of its stack pid has used so far, or RTX_ERR if it has no stack */
+extern int __svc(SVC_GET_STACK_USAGE) get_stack_usage(int pid);
+
+/* Memory Management */
+extern void *__svc(SVC_REQUEST_MEMORY_BLOCK) request_memory_block(void);
+/* Same as request_memory_block, but gives up after ms milliseconds and returns NULL.
+   ms == 0 never blocks. */
+extern void *__svc(SVC_REQUEST_MEMORY_BLOCK_TIMEOUT) request_memory_block_timeout(int ms);
+/* A block of at least size bytes, MEM_BLOCK_SIZE_SMALL, MEM_BLOCK_SIZE or MEM_BLOCK_SIZE_LARGE.
+   NULL if size is larger than MEM_BLOCK_SIZE_LARGE. */
+extern void *__svc(SVC_REQUEST_MEMORY_BLOCK_SIZED) request_memory_block_sized(int size);
+extern int __svc(SVC_RELEASE_MEMORY_BLOCK) release_memory_block(void *p_mem_blk);
+
+/* IPC Management */
+extern int __svc(SVC_SEND_MESSAGE) send_message(int pid, void *p_msg);
+/* Send one memory block to every pid in pid_mask (PID_BIT(pid) | ...), without
+   copying it. The receivers share it and must not change it. Each releases it
+   as usual, and it's freed once they all have. It can't be delayed_send. */
+extern int __svc(SVC_MULTICAST_MESSAGE) multicast_message(unsigned int pid_mask, void *p_msg);
+extern void *__svc(SVC_RECEIVE_MESSAGE) receive_message(int *p_pid);
+/* Same as receive_message, but gives up after ms milliseconds and returns NULL.
+   ms == 0 never blocks. */
+extern void *__svc(SVC_RECEIVE_MESSAGE_TIMEOUT) receive_message_timeout(int *p_pid, int ms);
+/* Receive the oldest message from a sender in pid_mask (PID_BIT(pid) | ..., or PID_ANY)
+   with type mtype (or MTYPE_ANY). Blocks until one arrives. Other messages stay
+   in the mailbox, in order. */
+extern void *__svc(SVC_RECEIVE_MESSAGE_MATCH) receive_message_match(int *p_pid, unsigned int pid_mask, int mtype);
+/* The oldest message, or NULL right away if there's none */
+extern void *__svc(SVC_NON_BLOCKING_RECEIVE_MESSAGE) non_blocking_receive_message(int *p_pid);
+/* Receive up to max messages into p_msgs, oldest first, and their senders into
+   p_pids unless it's NULL. Blocks until there's at least one.
+   Returns how many, or RTX_ERR if max isn't positive. */
+extern int __svc(SVC_RECEIVE_MESSAGES) receive_messages(void *p_msgs[], int p_pids[], int max);
+/* Send p_msg to pid, and block until pid replies. Returns the reply, or NULL if
+   p_msg can't be sent or pid exits without replying. pid receives p_msg as usual. */
+extern void *__svc(SVC_CALL) call(int pid, void *p_msg);
+/* Answer pid's call with p_msg. RTX_ERR if pid isn't waiting on a call to us. */
+extern int __svc(SVC_REPLY) reply(int pid, void *p_msg);
+
+/* Timing Service */
+extern int __svc(SVC_DELAYED_SEND) delayed_send(int pid, void *p_msg, int delay);
+/* Take back a message that delayed_send hasn't delivered yet, or deliver it
+   delay ms from now instead. Only the sender can. RTX_ERR once it's delivered. */
+extern int __svc(SVC_CANCEL_DELAYED_SEND) cancel_delayed_send(void *p_msg);
+extern int __svc(SVC_RESCHEDULE_DELAYED_SEND) reschedule_delayed_send(void *p_msg, int delay);
+/* Send p_msg every period ms, on a fixed schedule, until the sender cancels it
+   with cancel_delayed_send. The receiver gets the same envelope each time and
+   must not release it. m_kdata[0] is the number of periods since it was last
+   received, more than 1 if the receiver fell behind. If the sender exits, it
+   stops, and a receiver that has had it owns it like any other block. */
+extern int __svc(SVC_PERIODIC_SEND) periodic_send(int pid, void *p_msg, int period);
+/* Block for ms milliseconds. Messages that arrive meanwhile wait in the mailbox. */
+extern int __svc(SVC_SLEEP) sleep(int ms);
+
+#include "disallow_k.h"
+#endif /* !RTX_H_ */
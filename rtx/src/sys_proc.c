@@ -9,7 +9,8 @@
 //#include <stdlib.h>
 #include <ucontext.h>
 #include <unistd.h>
-#include <queue>
+#include <deque>
+#include <algorithm>
 #define _vsnprintf vsnprintf
 #define _sscanf sscanf
 typedef struct mem_t{
@@ -37,10 +38,13 @@ static void kcd_register(const char *cmd_prefix) {
 static int send_message(int dst, struct msgbuf *msg);
 
 static int delayed_send(int dst, struct msgbuf *msg, int delay_ms);
+static int cancel_delayed_send(struct msgbuf *msg);
+static int periodic_send(int dst, struct msgbuf *msg, int period_ms);
 
 struct msgbuf *receive_message(int *from);
 
-#define request_memory_block() malloc(128)
+static int test_allocs = 0;
+#define request_memory_block() (++test_allocs, malloc(128))
 
 #define release_memory_block(x) free((x))
 
@@ -48,9 +52,10 @@ struct msgbuf *receive_message(int *from);
 
 static void kcd_register(const char *cmd_prefix)
 {
-	assert(strlen(cmd_prefix) <= MTEXT_MAXLEN);
+	assert(strlen(cmd_prefix) <= MTEXT_MAXLEN_OF(MEM_BLOCK_SIZE_SMALL));
 
-	struct msgbuf *p_msg_env = (struct msgbuf *)request_memory_block();
+	// KCD keeps it as long as we run
+	struct msgbuf *p_msg_env = (struct msgbuf *)request_memory_block_sized(MEM_BLOCK_SIZE_SMALL);
 	p_msg_env->mtype = KCD_REG;
 	strcpy(p_msg_env->mtext, cmd_prefix);
 	send_message(PID_KCD, p_msg_env);
@@ -73,42 +78,49 @@ static int crt_printf(const char *fmt, ...) {
 	return ret;
 }
 
-volatile int clock_tick = 0;
+/* The periodic tick, or NULL while the clock is stopped */
+static struct msgbuf *clock_msg = NULL;
 volatile unsigned int clock_h, clock_m, clock_s;
 
 /**
- * Print the time and schedule another tick.
- * Optionally take a message with the expected clock tick.
+ * Print the time, and tick every second from 1 s from now.
+ * The tick message is allocated once, and reused from then on.
  */
-static void clock_handle_tick(struct msgbuf *msg)
+static void clock_start(void)
 {
-	if (msg) {
-		int clock_tick_ = clock_tick;
-		if (memcmp(msg->mtext, &clock_tick_, sizeof(clock_tick_))) {
-			return;
-		}
-		if ((clock_s = (clock_s + 1) % 60) == 0) {
-			if ((clock_m = (clock_m + 1) % 60) == 0) {
-				if ((clock_h = (clock_h + 1) % 24) == 0) {
-					// next day, do nothing
-				}
-			}
-		}
-		struct msgbuf *const msg2 = (struct msgbuf *)request_memory_block();
-		memcpy(msg2, msg, 128);
-		msg = msg2;
-	} else {
-		msg = (struct msgbuf *)request_memory_block();
-		msg->mtype = DEFAULT;
+	// Cancelling also drops a tick that's waiting in our mailbox
+	if (clock_msg == NULL || cancel_delayed_send(clock_msg) != RTX_OK) {
+		clock_msg = (struct msgbuf *)request_memory_block();
+		clock_msg->mtype = DEFAULT;
 	}
-
+	periodic_send(PID_CLOCK, clock_msg, 1000);
 	crt_printf("Wall clock: %02u:%02u:%02u\n", clock_h, clock_m, clock_s);
+}
 
-	{
-		int clock_tick_ = clock_tick;
-		memcpy(msg->mtext, &clock_tick_, sizeof(clock_tick_));
+static void clock_stop(void)
+{
+	if (clock_msg != NULL && cancel_delayed_send(clock_msg) == RTX_OK) {
+		release_memory_block(clock_msg);
+	}
+	clock_msg = NULL;
+}
+
+/**
+ * Advance the time by the seconds the tick stands for, and print it.
+ * Returns false if msg isn't the tick, and should be released.
+ */
+static bool clock_handle_tick(struct msgbuf *msg)
+{
+	if (msg != clock_msg) {
+		return false;
 	}
-	delayed_send(PID_CLOCK, msg, 1000);
+	// More than one period if we fell behind, so the clock never loses time
+	const unsigned int secs = (clock_h * 60 + clock_m) * 60 + clock_s + msg->m_kdata[0];
+	clock_s = secs % 60;
+	clock_m = secs / 60 % 60;
+	clock_h = secs / (60 * 60) % 24;
+	crt_printf("Wall clock: %02u:%02u:%02u\n", clock_h, clock_m, clock_s);
+	return true;
 }
 
 bool check_invalid_chars(char* cmd) {
@@ -147,7 +159,7 @@ static void clock_handle_message(struct msgbuf *cmd)
       case 'T':
 			/* The %WT command will cause the wall clock display to be terminated.
 			 */
-				++clock_tick;
+				clock_stop();
 				break;
       case 'R':
 			/* The %WR command will reset the current wall clock time to 00:00:00, starts the clock
@@ -158,8 +170,7 @@ static void clock_handle_message(struct msgbuf *cmd)
 				clock_h = h;
 				clock_m = m;
 				clock_s = s;
-				++clock_tick;
-				clock_handle_tick(NULL);
+				clock_start();
 				break;
       case 'S': {
 			/* The %WS hh:mm:ss command sets the current wall clock time to hh:mm:ss, starts
@@ -188,8 +199,7 @@ static void clock_handle_message(struct msgbuf *cmd)
               clock_h = h;
               clock_m = m;
               clock_s = s;
-						  ++clock_tick;
-              clock_handle_tick(NULL);
+              clock_start();
               break;
           }
           printf("ERROR: Invalid wall clock display values %u:%u:%u\n", h, m, s);
@@ -216,7 +226,9 @@ void proc_clock(void)
 				clock_handle_message(msg);
 				break;
 			case PID_CLOCK:
-				clock_handle_tick(msg);
+				if (clock_handle_tick(msg)) {
+					continue; // the kernel sends it again next second
+				}
 				break;
 		}
 		release_memory_block(msg);
@@ -289,6 +301,96 @@ void proc_set_prio(void)
     release_memory_block(msg);
 	}
 }
+
+/* CPU usage display, toggled by %T */
+
+#define TOP_PERIOD_MS 1000
+/* Short names of PROC_STATE_E, in the same order */
+static const char *const top_state_names[] = {"NEW", "RDY", "RUN", "BLK_MEM", "BLK_MSG", "BLK_TMR", "BLK_RPL"};
+
+/* The periodic tick, or NULL while not showing */
+static struct msgbuf *top_msg = NULL;
+static PROC_CPU top_prev[NUM_PROCS], top_now[NUM_PROCS];
+static bool top_valid[NUM_PROCS];
+
+/**
+ * Sample every process. If print, print the CPU% and switches/s of each
+ * since the last sample, a few processes per message.
+ */
+static void top_sample(bool print)
+{
+	U32 total = 0;
+	for (int pid = 0; pid < NUM_PROCS; ++pid) {
+		top_valid[pid] = get_cpu_usage(pid, &top_now[pid]) == RTX_OK;
+		if (top_valid[pid]) {
+			total += top_now[pid].m_cycles - top_prev[pid].m_cycles;
+		}
+	}
+
+	if (print && total > 0) {
+		char line[MTEXT_MAXLEN + 1];
+		int len = 0, in_line = 0;
+		crt_printf("PID  CPU%% SW/s   STATE PID  CPU%% SW/s   STATE PID  CPU%% SW/s   STATE\n");
+		for (int pid = 0; pid < NUM_PROCS; ++pid) {
+			if (!top_valid[pid]) {
+				continue;
+			}
+			const U32 cycles = top_now[pid].m_cycles - top_prev[pid].m_cycles;
+			const U32 switches = top_now[pid].m_switches - top_prev[pid].m_switches;
+			const U32 per_mille = (U32)((unsigned long long)cycles * 1000 / total);
+			const U32 per_sec = (U32)((unsigned long long)switches * CORE_CLK_HZ / total);
+			const int state = top_now[pid].m_state;
+			const char *const state_name =
+				0 <= state && state < sizeof(top_state_names) / sizeof(top_state_names[0]) ? top_state_names[state] : "?";
+			sprintf(line + len, "%3d %3u.%u %4u %7s ", pid, per_mille / 10, per_mille % 10, per_sec, state_name);
+			len += strlen(line + len);
+			if (++in_line == 3) {
+				crt_printf("%s\n", line);
+				len = in_line = 0;
+			}
+		}
+		if (in_line > 0) {
+			crt_printf("%s\n", line);
+		}
+	}
+	memcpy(top_prev, top_now, sizeof(top_prev));
+}
+
+/**
+ * CPU usage display process.
+ * %T starts printing the CPU usage of every process every TOP_PERIOD_MS,
+ * and %T again stops it.
+ */
+void proc_top(void)
+{
+	kcd_register("%T");
+
+	for (;;) {
+		int sender_id = -1;
+		struct msgbuf *msg = receive_message(&sender_id);
+		if (sender_id == PID_KCD) {
+			msg->mtext[MTEXT_MAXLEN] = '\0';
+			if (strcmp(msg->mtext, "%T") != 0) {
+				printf("Invalid command: %s\n", msg->mtext);
+			} else if (top_msg == NULL) {
+				top_sample(false);
+				top_msg = msg;
+				periodic_send(PID_TOP, msg, TOP_PERIOD_MS);
+				continue; // reused for every tick
+			} else {
+				// Also drops a tick that's waiting in our mailbox
+				if (cancel_delayed_send(top_msg) == RTX_OK) {
+					release_memory_block(top_msg);
+				}
+				top_msg = NULL;
+			}
+		} else if (sender_id == PID_TOP && msg == top_msg) {
+			top_sample(true);
+			continue; // the kernel sends it again next period
+		}
+		release_memory_block(msg);
+	}
+}
 #endif
 
 #ifdef USR_CLOCK_TEST
@@ -304,7 +406,7 @@ static void test_expect(const char *buf) {
 static ucontext_t test_clock, test_main;
 static int test_from;
 static struct msgbuf *test_msgbuf = NULL;
-static std::queue<struct msgbuf *> test_delayed_msg;
+static std::deque<struct msgbuf *> test_delayed_msg;
 
 static void test_input(const char *buf) {
 	test_from = PID_KCD;
@@ -324,10 +426,37 @@ static int send_message(int dst, struct msgbuf *msg) {
 
 static int delayed_send(int dst, struct msgbuf *msg, int delay_ms) {
 	assert(dst == PID_CLOCK);
-	test_delayed_msg.push(msg);
+	test_delayed_msg.push_back(msg);
 	return RTX_OK;
 }
 
+static struct msgbuf *test_periodic_msg = NULL;
+static int test_periodic_sends = 0;
+
+// Delivered by test_sleep, then queued again for the next period
+static int periodic_send(int dst, struct msgbuf *msg, int period_ms) {
+	assert(dst == PID_CLOCK && test_periodic_msg == NULL);
+	test_periodic_msg = msg;
+	++test_periodic_sends;
+	return delayed_send(dst, msg, period_ms);
+}
+
+static int cancel_delayed_send(struct msgbuf *msg) {
+	std::deque<struct msgbuf *>::iterator it =
+		std::find(test_delayed_msg.begin(), test_delayed_msg.end(), msg);
+	if (it == test_delayed_msg.end()) {
+		return RTX_ERR;
+	}
+	test_delayed_msg.erase(it);
+	if (msg == test_periodic_msg) {
+		test_periodic_msg = NULL;
+	}
+	return RTX_OK;
+}
+
+// How many periods the next periodic delivery stands for
+static int test_periods = 1;
+
 static void test_sleep(void) {
 	if (test_delayed_msg.empty()) {
 		return;
@@ -336,7 +465,12 @@ static void test_sleep(void) {
 	printf("Sleeping...\n");
 	test_from = PID_CLOCK;
 	test_msgbuf = test_delayed_msg.front();
-	test_delayed_msg.pop();
+	test_delayed_msg.pop_front();
+	if (test_msgbuf == test_periodic_msg) {
+		test_msgbuf->m_kdata[0] = test_periods;
+		test_periods = 1;
+		test_delayed_msg.push_back(test_msgbuf);
+	}
 	swapcontext(&test_main, &test_clock);
 }
 
@@ -394,6 +528,8 @@ int main(void)
 	test_sleep();
 	test_expect("Wall clock: 00:00:03\n");
 	test_input("%WT");
+	// The pending tick was cancelled, not left to fire
+	assert(test_delayed_msg.empty());
 	test_sleep();
 
 	printf("\x1b[1mTesting %%WS\x1b[0m\n");
@@ -406,6 +542,29 @@ int main(void)
 	test_sleep_ntimes(11 * 60 * 60);
 	test_expect("Wall clock: 00:00:00\n");
 
+	printf("\x1b[1mTesting %%WS while running\x1b[0m\n");
+	test_input("%WS 01:02:03");
+	test_expect("Wall clock: 01:02:03\n");
+	// The pending tick was rescheduled, not replaced
+	assert(test_delayed_msg.size() == 1);
+	test_sleep();
+	test_expect("Wall clock: 01:02:04\n");
+
+	printf("\x1b[1mTesting an hour of ticks\x1b[0m\n");
+	test_input("%WS 05:00:00");
+	{
+		const int allocs = test_allocs, sends = test_periodic_sends;
+		test_sleep_ntimes(60 * 60);
+		test_expect("Wall clock: 06:00:00\n");
+		// One block per line printed, and none for the ticks
+		assert(test_allocs - allocs == 60 * 60);
+		assert(test_periodic_sends == sends);
+	}
+	// Fell 3 periods behind, and catches up in one tick
+	test_periods = 3;
+	test_sleep();
+	test_expect("Wall clock: 06:00:03\n");
+
 	printf("\x1b[1mTesting time format\x1b[0m\n");
 	strcpy(test_last_line, "");
 	test_input("%WS 99:99:99");
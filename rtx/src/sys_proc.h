@@ -3,4 +3,5 @@
 
 void proc_clock(void);
 void proc_set_prio(void);
+void proc_top(void);
 #endif /* USR_CLOCK_H_ */
@@ -63,6 +63,18 @@ uint32_t timer_init(uint8_t n_timer)
 	-----------------------------------------------------
 	*/
 
+#ifdef HAS_TICKLESS_IDLE
+	/* Step 4.1: Prescale Register PR setting
+	   CCLK = 100 MHZ, PCLK = CCLK/4 = 25 MHZ
+	   (24999 + 1)*(1/25) * 10^(-6) s = 10^(-3) s = 1 ms
+	   TC (Timer Counter) counts milliseconds and is never reset
+	*/
+	pTimer->PR = 24999;
+
+	/* Step 4.2 & 4.3: No MR0 interrupt until timer_set_deadline() arms one */
+	pTimer->MR0 = 0;
+	pTimer->MCR = 0;
+#else
 	/* Step 4.1: Prescale Register PR setting 
 	   CCLK = 100 MHZ, PCLK = CCLK/4 = 25 MHZ
 	   2*(12499 + 1)*(1/25) * 10^(-6) s = 10^(-3) s = 1 ms
@@ -80,6 +92,7 @@ uint32_t timer_init(uint8_t n_timer)
 	   Reset on MR0: Reset TC if MR0 mathches it.
 	*/
 	pTimer->MCR = BIT(0) | BIT(1);
+#endif
 
 	g_timer_count = 0;
 
@@ -94,38 +107,78 @@ uint32_t timer_init(uint8_t n_timer)
 
 /**
  * @brief: use CMSIS ISR for TIMER0 IRQ Handler
- * NOTE: This example shows how to save/restore all registers rather than just
- *       those backed up by the exception stack frame. We add extra
- *       push and pop instructions in the assembly routine. 
- *       The actual c_TIMER0_IRQHandler does the rest of irq handling
+ * NOTE: The ISR never switches processes itself, PendSV_Handler does,
+ *       so the exception stack frame is all that needs saving.
+ */
+void TIMER0_IRQHandler(void)
+{
+	const pid_t account_pid = k_account_isr_enter(PID_TIMER_IPROC);
+#ifdef HAS_TICKLESS_IDLE
+	/* ack first, so a deadline re-armed by proc_timer_i() is not lost */
+	LPC_TIM0->IR = BIT(0);
+
+	// We may have slept through many ticks, so catch up with the hardware
+	timer_now();
+
+	// Call the actual timer-i process
+	proc_timer_i();
+#else
+	g_timer_count++;
+
+	// Call the actual timer-i process
+	proc_timer_i();
+
+	/* ack inttrupt, see section  21.6.1 on pg 493 of LPC17XX_UM */
+	LPC_TIM0->IR = BIT(0);  
+#endif
+	k_account_isr_exit(account_pid);
+}
+
+/**
+ * @brief: current time in ms. Corrects g_timer_count, which goes stale
+ *         while tickless idle is sleeping.
  */
-__asm void TIMER0_IRQHandler(void)
+uint32_t timer_now(void)
 {
-	PRESERVE8
-	IMPORT c_TIMER0_IRQHandler
-	PUSH{r4-r11, lr}
-	BL c_TIMER0_IRQHandler
-	POP{r4-r11, pc}
-} 
+#ifdef HAS_TICKLESS_IDLE
+	g_timer_count = LPC_TIM0->TC;
+#endif
+	return g_timer_count;
+}
+
 /**
- * @brief: c TIMER0 IRQ Handler
+ * @brief: interrupt when g_timer_count reaches deadline.
+ *         Without tickless idle, the timer interrupts every 1 ms anyway.
  */
-void c_TIMER0_IRQHandler(void)
+void timer_set_deadline(uint32_t deadline)
 {
-	g_timer_count++;
+#ifdef HAS_TICKLESS_IDLE
+	LPC_TIM0->MR0 = deadline;
+	LPC_TIM0->MCR = BIT(0);
+	// The match only fires on equality, so don't miss a deadline that already passed
+	if ((int32_t)(deadline - LPC_TIM0->TC) <= 0) {
+		NVIC_SetPendingIRQ(TIMER0_IRQn);
+	}
+#endif
+}
 
-	// Call the actual timer-i process
-	proc_timer_i();
-
-	/* ack inttrupt, see section  21.6.1 on pg 493 of LPC17XX_UM */
-	LPC_TIM0->IR = BIT(0);  
+/**
+ * @brief: no deadline pending, so let the processor sleep
+ */
+void timer_clear_deadline(void)
+{
+#ifdef HAS_TICKLESS_IDLE
+	LPC_TIM0->MCR = 0;
+#endif
 }
 
 void proc_timer_i(void) {
-	k_check_delayed_messages();
-#ifdef HAS_TIMESLICING
-	k_check_preemption_eager();
-#else
-	k_check_preemption();
+	const bool sent = k_check_delayed_messages();
+#ifdef HAS_TIMESLICING
+	k_check_preemption_eager();
 #endif
+	// Only a newly ready receiver can preempt
+	if (sent) {
+		k_check_preemption();
+	}
 }
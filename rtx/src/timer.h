@@ -6,12 +6,16 @@
  
 #ifndef _TIMER_H_
 #define _TIMER_H_
-
-#include <stdint.h>
+
+#include <stdint.h>
 
 extern uint32_t timer_init ( uint8_t n_timer );  /* initialize timer n_timer */
 extern volatile uint32_t g_timer_count;
 
+uint32_t timer_now(void);
+void timer_set_deadline(uint32_t deadline);
+void timer_clear_deadline(void);
+
 void proc_timer_i(void);
 
 #endif /* ! _TIMER_H_ */
@@ -0,0 +1,414 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdbool.h>
+#ifdef TIMER_WHEEL_TEST
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#endif
+#include "timer_wheel.h"
+
+#ifdef __ARMCC_VERSION
+#define tw_clz(x) __clz(x)
+#else
+#define tw_clz(x) __builtin_clz(x)
+#endif
+
+#define SLOT_MASK (TW_SLOTS - 1)
+#define WHERE_DUE (TW_LEVELS * TW_SLOTS + 1)
+
+static bool is_before_or_at(U32 a, U32 b) {
+	return (int)(a - b) <= 0;
+}
+
+static timer_node_t **tw_list(timer_wheel_t *w, U32 where) {
+	assert(0 < where && where <= WHERE_DUE);
+	return where == WHERE_DUE ? &w->mp_due : &w->mp_slots[where - 1];
+}
+
+static void list_push_back(timer_node_t **list, timer_node_t *node) {
+	node->mp_next = NULL;
+	if (*list) {
+		timer_node_t *const back = (*list)->mp_prev;
+		back->mp_next = node;
+		node->mp_prev = back;
+		(*list)->mp_prev = node;
+	} else {
+		node->mp_prev = node;
+		*list = node;
+	}
+}
+
+static void list_unlink(timer_node_t **list, timer_node_t *node) {
+	timer_node_t *const next = node->mp_next, *const prev = node->mp_prev;
+	if (node == *list) {
+		*list = next;
+	} else {
+		prev->mp_next = next;
+	}
+	if (next) {
+		next->mp_prev = prev;
+	} else if (*list) {
+		(*list)->mp_prev = prev;
+	}
+	node->mp_next = node->mp_prev = NULL;
+}
+
+// Put node in the slot for its expiry, relative to w->m_now
+static void tw_place(timer_wheel_t *w, timer_node_t *node) {
+	if (is_before_or_at(node->m_expiry, w->m_now)) {
+		node->m_where = WHERE_DUE;
+		list_push_back(&w->mp_due, node);
+		return;
+	}
+	// Only the top level can wrap around, since a lower level would be > 2^31 ms away
+	const int level = (31 - tw_clz(node->m_expiry ^ w->m_now)) / TW_LEVEL_BITS;
+	const int slot = (node->m_expiry >> (level * TW_LEVEL_BITS)) & SLOT_MASK;
+	const int index = level * TW_SLOTS + slot;
+	node->m_where = index + 1;
+	list_push_back(&w->mp_slots[index], node);
+	w->m_bitmap[level] |= 1u << slot;
+}
+
+/*
+ * The next slot to process, and when. Every slot of a level comes before the
+ * next level's, since they are all within the same slot of the next level.
+ */
+static bool tw_next_event(const timer_wheel_t *w, U32 *when, U32 *where) {
+	if (w->mp_due) {
+		*when = w->m_now;
+		*where = WHERE_DUE;
+		return true;
+	}
+	for (int level = 0; level < TW_LEVELS; ++level) {
+		const U32 bits = w->m_bitmap[level];
+		if (!bits) {
+			continue;
+		}
+		const int shift = level * TW_LEVEL_BITS;
+		const int current = (w->m_now >> shift) & SLOT_MASK;
+		const U32 later = bits & ~((2u << current) - 1);
+		const U32 next = later ? later : bits;      // wrapped around, top level only
+		const int slot = 31 - tw_clz(next & -next); // lowest set bit
+		const U32 base = level == TW_LEVELS - 1 ? 0 : w->m_now & ~((TW_SLOTS << shift) - 1);
+		*when = base | ((U32)slot << shift);
+		*where = level * TW_SLOTS + slot + 1;
+		return true;
+	}
+	return false;
+}
+
+void tw_add(timer_wheel_t *w, timer_node_t *node, U32 now, U32 delay) {
+	assert(!tw_pending(node) && node->mpf_expire);
+	// An empty wheel may have been left far behind by tickless idle
+	if (tw_is_empty(w)) {
+		w->m_now = now;
+	}
+	node->m_expiry = now + delay;
+	tw_place(w, node);
+}
+
+bool tw_remove(timer_wheel_t *w, timer_node_t *node) {
+	if (!tw_pending(node)) {
+		return false;
+	}
+	const U32 where = node->m_where;
+	timer_node_t **const list = tw_list(w, where);
+	list_unlink(list, node);
+	if (!*list && where != WHERE_DUE) {
+		w->m_bitmap[(where - 1) / TW_SLOTS] &= ~(1u << ((where - 1) & SLOT_MASK));
+	}
+	node->m_where = 0;
+	return true;
+}
+
+int tw_remove_if(timer_wheel_t *w, bool (*match)(const timer_node_t *node, int arg), int arg) {
+	int removed = 0;
+	for (U32 where = 1; where <= WHERE_DUE; ++where) {
+		timer_node_t *node = *tw_list(w, where);
+		while (node) {
+			timer_node_t *const next = node->mp_next;
+			if (match(node, arg)) {
+				tw_remove(w, node);
+				++removed;
+			}
+			node = next;
+		}
+	}
+	return removed;
+}
+
+bool tw_pending(const timer_node_t *node) {
+	return node->m_where != 0;
+}
+
+bool tw_is_empty(const timer_wheel_t *w) {
+	if (w->mp_due) {
+		return false;
+	}
+	for (int level = 0; level < TW_LEVELS; ++level) {
+		if (w->m_bitmap[level]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int tw_advance(timer_wheel_t *w, U32 now) {
+	int expired = 0;
+	U32 when, where;
+	while (tw_next_event(w, &when, &where) && is_before_or_at(when, now)) {
+		// Take the whole slot, so expiring a timer never touches the others
+		timer_node_t *node = *tw_list(w, where);
+		*tw_list(w, where) = NULL;
+		if (where != WHERE_DUE) {
+			w->m_bitmap[(where - 1) / TW_SLOTS] &= ~(1u << ((where - 1) & SLOT_MASK));
+		}
+		w->m_now = when;
+
+		const bool cascade = where != WHERE_DUE && where > TW_SLOTS;
+		while (node) {
+			timer_node_t *const next = node->mp_next;
+			node->mp_next = node->mp_prev = NULL;
+			node->m_where = 0;
+			if (cascade) {
+				tw_place(w, node);
+			} else {
+				node->mpf_expire(node);
+				++expired;
+			}
+			node = next;
+		}
+	}
+	if (is_before_or_at(w->m_now, now)) {
+		w->m_now = now;
+	}
+	return expired;
+}
+
+bool tw_next_deadline(const timer_wheel_t *w, U32 *deadline) {
+	U32 where;
+	return tw_next_event(w, deadline, &where);
+}
+
+#ifdef TIMER_WHEEL_TEST
+// gcc -std=gnu99 -o timer_wheel timer_wheel.c -DTIMER_WHEEL_TEST -Wall -g3 && ./timer_wheel
+
+#define NUM_TIMERS 500
+
+static timer_node_t nodes[NUM_TIMERS];
+static U32 expired_at[NUM_TIMERS];
+static U32 clock_now;
+
+static void record_expiry(timer_node_t *node) {
+	const int i = node - nodes;
+	assert(expired_at[i] == 0);
+	// Never early, never late
+	assert(node->m_expiry == clock_now);
+	expired_at[i] = clock_now + 1;
+}
+
+static bool is_odd(const timer_node_t *node, int arg) {
+	return (node - nodes) % 2 == arg;
+}
+
+// The same timers in a sorted list, like the old delayed message queue
+typedef struct list_timer {
+	struct list_timer *next;
+	U32 expiry;
+} list_timer_t;
+
+static list_timer_t list_nodes[NUM_TIMERS];
+
+static void list_insert(list_timer_t **list, list_timer_t *t) {
+	while (*list && is_before_or_at((*list)->expiry, t->expiry)) {
+		list = &(*list)->next;
+	}
+	t->next = *list;
+	*list = t;
+}
+
+// Tick one ms at a time, the way the timer works without tickless idle
+static void run_ticks(timer_wheel_t *w, U32 ticks) {
+	for (U32 i = 0; i < ticks; ++i) {
+		++clock_now;
+		tw_advance(w, clock_now);
+	}
+}
+
+// Jump straight to each deadline, the way tickless idle does
+static void run_tickless(timer_wheel_t *w, U32 until) {
+	U32 deadline;
+	while (tw_next_deadline(w, &deadline) && is_before_or_at(deadline, until)) {
+		// A deadline is never in the past, so no timer is late
+		assert(is_before_or_at(clock_now, deadline));
+		clock_now = deadline;
+		tw_advance(w, clock_now);
+	}
+	clock_now = until;
+	tw_advance(w, clock_now);
+}
+
+static void test_random(U32 start, bool tickless) {
+	static timer_wheel_t w;
+	memset(&w, 0, sizeof(w));
+	memset(nodes, 0, sizeof(nodes));
+	memset(expired_at, 0, sizeof(expired_at));
+	clock_now = start;
+
+	U32 max_delay = 0;
+	for (int i = 0; i < NUM_TIMERS; ++i) {
+		nodes[i].mpf_expire = &record_expiry;
+		// A mix of short and very long timers, to use every level.
+		// Zero delay expires on the next tw_advance, which test_basic covers.
+		const U32 delay = 1 + ((rand() % 3 == 0) ? (U32)rand() % 20 : (U32)rand() % (1u << (rand() % 20)));
+		if (delay > max_delay) {
+			max_delay = delay;
+		}
+		tw_add(&w, &nodes[i], clock_now, delay);
+		if (i % 50 == 0) {
+			run_ticks(&w, 3);
+		}
+	}
+	// Cancel the last one, which can't have expired yet
+	const int removed = NUM_TIMERS - 1;
+	assert(tw_remove(&w, &nodes[removed]));
+	assert(!tw_remove(&w, &nodes[removed]));
+
+	if (tickless) {
+		run_tickless(&w, clock_now + max_delay + 1);
+	} else if (max_delay < 100000) {
+		run_ticks(&w, max_delay + 1);
+	} else {
+		run_tickless(&w, clock_now + max_delay + 1);
+	}
+	assert(tw_is_empty(&w));
+	for (int i = 0; i < NUM_TIMERS; ++i) {
+		assert(!tw_pending(&nodes[i]));
+		assert(i == removed ? expired_at[i] == 0 : expired_at[i] - 1 == nodes[i].m_expiry);
+	}
+}
+
+static void test_basic(void) {
+	static timer_wheel_t w;
+	U32 deadline;
+	memset(nodes, 0, sizeof(nodes));
+	memset(expired_at, 0, sizeof(expired_at));
+
+	assert(tw_is_empty(&w));
+	assert(!tw_next_deadline(&w, &deadline));
+	assert(tw_advance(&w, 1000) == 0);
+
+	// Zero delay is due straight away
+	clock_now = 1000;
+	nodes[0].mpf_expire = &record_expiry;
+	tw_add(&w, &nodes[0], clock_now, 0);
+	assert(tw_next_deadline(&w, &deadline) && deadline == 1000);
+	assert(tw_advance(&w, clock_now) == 1);
+	assert(expired_at[0] == 1001);
+
+	// Remove every other one, then the rest expire together
+	for (int i = 0; i < 10; ++i) {
+		nodes[i].mpf_expire = &record_expiry;
+		expired_at[i] = 0;
+		tw_add(&w, &nodes[i], clock_now, 300);
+	}
+	assert(tw_remove_if(&w, &is_odd, 1) == 5);
+	clock_now += 299;
+	assert(tw_advance(&w, clock_now) == 0);
+	clock_now += 1;
+	assert(tw_advance(&w, clock_now) == 5);
+	for (int i = 0; i < 10; ++i) {
+		assert((expired_at[i] != 0) == (i % 2 == 0));
+	}
+	assert(tw_is_empty(&w));
+}
+
+#define PERIOD 1000
+
+static timer_wheel_t *periodic_wheel;
+static U32 periodic_start;
+static U32 periodic_count;
+
+// Re-added from its own deadline, the way k_expire_periodic_message does
+static void periodic_expire(timer_node_t *node) {
+	++periodic_count;
+	assert(node->m_expiry == periodic_start + periodic_count * PERIOD);
+	tw_add(periodic_wheel, node, node->m_expiry, PERIOD);
+}
+
+// An hour of a periodic timer, processed up to 1.5 periods late, doesn't drift
+static void test_periodic(void) {
+	static timer_wheel_t w;
+	static timer_node_t node;
+	periodic_wheel = &w;
+	clock_now = periodic_start = 0xFFFF0000u;
+	node.mpf_expire = &periodic_expire;
+	tw_add(&w, &node, clock_now, PERIOD);
+
+	while (clock_now - periodic_start < 60 * 60 * PERIOD) {
+		clock_now += 1 + rand() % (PERIOD * 3 / 2);
+		tw_advance(&w, clock_now);
+	}
+	assert(periodic_count == (clock_now - periodic_start) / PERIOD);
+	assert(tw_remove(&w, &node) && tw_is_empty(&w));
+}
+
+static double seconds(clock_t start) {
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Insert NUM_TIMERS random timers, then expire them, many times over
+static void benchmark(void) {
+	static timer_wheel_t w;
+	const int rounds = 2000;
+	list_timer_t *list = NULL;
+
+	clock_t start = clock();
+	for (int round = 0; round < rounds; ++round) {
+		memset(&w, 0, sizeof(w));
+		memset(nodes, 0, sizeof(nodes));
+		clock_now = 0;
+		for (int i = 0; i < NUM_TIMERS; ++i) {
+			nodes[i].mpf_expire = &record_expiry;
+			tw_add(&w, &nodes[i], clock_now, 1 + (i * 7919) % 10000);
+		}
+		memset(expired_at, 0, sizeof(expired_at));
+		run_tickless(&w, 10001);
+	}
+	const double wheel = seconds(start);
+
+	start = clock();
+	for (int round = 0; round < rounds; ++round) {
+		list = NULL;
+		for (int i = 0; i < NUM_TIMERS; ++i) {
+			list_nodes[i].expiry = 1 + (i * 7919) % 10000;
+			list_insert(&list, &list_nodes[i]);
+		}
+		while (list) {
+			list = list->next;
+		}
+	}
+	const double sorted = seconds(start);
+
+	printf("%d timers outstanding, %d rounds: timing wheel %.3fs, sorted list %.3fs\n",
+		NUM_TIMERS, rounds, wheel, sorted);
+}
+
+int main(void) {
+	srand(350);
+	test_basic();
+	for (int i = 0; i < 20; ++i) {
+		test_random((U32)rand(), i % 2);
+	}
+	// The clock wraps around in the middle
+	test_random(0xFFFFFF00u, false);
+	test_random(0xFFFF0000u, true);
+	test_random(0x7FFFFFF0u, true);
+	test_periodic();
+	benchmark();
+	printf("All passed!\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,70 @@
+/**
+ * @file:   timer_wheel.h
+ * @brief:  Hierarchical timing wheel. O(1) timer insert and removal, and
+ *          expiry in bulk, however many timers are outstanding.
+ */
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <stdbool.h>
+#include "common.h"
+
+/*
+ * 8 levels of 16 slots cover all 32 bits of the millisecond clock.
+ * A timer goes in the level of the highest 4-bit digit where its expiry time
+ * differs from the wheel's time, in the slot of that digit. When the wheel's
+ * time reaches a slot of level > 0, its timers cascade to lower levels, so
+ * each timer moves at most 7 times before it expires from level 0.
+ */
+#define TW_LEVEL_BITS 4
+#define TW_SLOTS      (1 << TW_LEVEL_BITS)
+#define TW_LEVELS     (32 / TW_LEVEL_BITS)
+
+/*
+ * A timer, embedded in whatever it times, such as the m_kdata of a MSG_BUF.
+ * Set mpf_expire before adding it. A zero-initialized node is not pending.
+ */
+typedef struct timer_node {
+	struct timer_node *mp_next;
+	struct timer_node *mp_prev;            /* for the front of a slot, the back */
+	U32 m_expiry;                          /* clock time it expires at */
+	void (*mpf_expire)(struct timer_node *node);
+	U32 m_where;                           /* slot + 1 it is in, or 0 if not pending */
+} timer_node_t;
+
+/*
+ * Bit s of bitmap[level] is set iff that slot is non-empty, so the next slot
+ * to process is found with a count-leading-zeros per level.
+ * Times are compared as (int)(a - b), so the clock may wrap around, as long as
+ * no timer is more than 2^31 ms away. A zero-initialized wheel is empty.
+ */
+typedef struct timer_wheel {
+	U32 m_now;                             /* every timer up to here has expired */
+	U32 m_bitmap[TW_LEVELS];
+	timer_node_t *mp_due;                  /* added at or before m_now, expire next */
+	timer_node_t *mp_slots[TW_LEVELS * TW_SLOTS];
+} timer_wheel_t;
+
+// Start node, expiring delay ms after now. node must not already be pending.
+void tw_add(timer_wheel_t *w, timer_node_t *node, U32 now, U32 delay);
+
+// Stop node. Returns false if it wasn't pending.
+bool tw_remove(timer_wheel_t *w, timer_node_t *node);
+
+// Stop every pending node that match() accepts. Returns how many were stopped.
+int tw_remove_if(timer_wheel_t *w, bool (*match)(const timer_node_t *node, int arg), int arg);
+
+bool tw_pending(const timer_node_t *node);
+
+bool tw_is_empty(const timer_wheel_t *w);
+
+// Call mpf_expire of every timer expiring at or before now, in expiry order.
+// mpf_expire may add timers, but not remove them. Returns how many expired.
+int tw_advance(timer_wheel_t *w, U32 now);
+
+// The time at which tw_advance next has work to do, or false if there are no
+// timers. It may be a cascade rather than an expiry, so it's never late, but
+// it can be early.
+bool tw_next_deadline(const timer_wheel_t *w, U32 *deadline);
+
+#endif /* ! TIMER_WHEEL_H_ */
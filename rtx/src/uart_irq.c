@@ -14,6 +14,8 @@
 #include "printf.h"
 #endif
 #include "k_process.h"
+#include "k_memory.h"
+#include "k_trace.h"
 #include "allow_k.h"
 
 #define UART(i) ((LPC_UART_TypeDef *)LPC_UART ## i)
@@ -27,23 +29,35 @@ LL_DECLARE(volatile outbuf, uint8_t, 200);
 LL_DECLARE(volatile inbuf, uint8_t, 200);
 MSG_BUF notif_in_msg;
 MSG_BUF notif_out_msg;
-
-static bool check_hotkey(uint8_t ch) {
-#ifdef _DEBUG_HOTKEYS
-	switch (ch) {
-		case HOTKEY_READY_QUEUE:
-			k_print_ready_queue();
-			return true;
-		case HOTKEY_BLOCKED_MEM_QUEUE:
-			k_print_blocked_on_memory_queue();
-			return true;
-		case HOTKEY_BLOCKED_MSG_QUEUE:
-			k_print_blocked_on_receive_queue();
-			return true;
-	}
-#endif
-	return false;
-}
+
+static bool check_hotkey(uint8_t ch) {
+#ifdef K_TRACE
+	if (ch == HOTKEY_TRACE_DUMP) {
+		k_trace_dump();
+		return true;
+	}
+#endif
+#ifdef _DEBUG_HOTKEYS
+	switch (ch) {
+		case HOTKEY_READY_QUEUE:
+			k_print_ready_queue();
+			return true;
+		case HOTKEY_BLOCKED_MEM_QUEUE:
+			k_print_blocked_on_memory_queue();
+			return true;
+		case HOTKEY_BLOCKED_MSG_QUEUE:
+			k_print_blocked_on_receive_queue();
+			return true;
+		case HOTKEY_MEMORY_BLOCKS:
+			k_print_memory_blocks();
+			return true;
+		case HOTKEY_STACK_USAGE:
+			k_print_stack_usage();
+			return true;
+	}
+#endif
+	return false;
+}
 
 // Send the input character to the appropriate process(es)
 static void uart_send_input_char(uint8_t ch) {
@@ -52,11 +66,11 @@ static void uart_send_input_char(uint8_t ch) {
 		return;
 	}
 	LL_PUSH_BACK(inbuf, ch);
-	if (ch == '\r') {
-		if (uart_iproc_notif_in) {
-			uart_iproc_notif_in = false;
-			notif_in_msg.mtype = DEFAULT;
-			k_send_message_helper(PID_UART_IPROC, PID_KCD, &notif_in_msg);
+	if (ch == '\r') {
+		if (uart_iproc_notif_in) {
+			uart_iproc_notif_in = false;
+			notif_in_msg.mtype = DEFAULT;
+			k_send_message_helper(PID_UART_IPROC, PID_KCD, &notif_in_msg);
 		}
 	}
 }
@@ -82,12 +96,12 @@ static void uart_putc_nonblocking(uint8_t ch) {
 	}
 	// LL_SIZE(outbuf) != 0
 	if (!uart_thre) {
-		// Ensure the THRE interrupt is enabled
+		// Ensure the THRE interrupt is enabled
 		ch = LL_POP_FRONT(outbuf);
-		uart_thre = true;
+		uart_thre = true;
 		LPC_UART_TypeDef *pUart = UART(0);
 		pUart->THR = ch;
-		pUart->IER |= IER_THRE; // Interrupt Enable Register: Transmit Holding Register Empty
+		pUart->IER |= IER_THRE; // Interrupt Enable Register: Transmit Holding Register Empty
 	}
 }
 
@@ -117,10 +131,10 @@ bool uart_iproc_putc(uint8_t ch) {
 			uart_iproc_notif_out = true;
 		}
 		ret = false;
-	} else {
-		if (ch == '\n') {
-			uart_putc_nonblocking('\r');
-		}
+	} else {
+		if (ch == '\n') {
+			uart_putc_nonblocking('\r');
+		}
 		uart_putc_nonblocking(ch);
 		ret = true;
 	}
@@ -263,24 +277,12 @@ int uart_irq_init(int n_uart) {
 
 /**
  * @brief: use CMSIS ISR for UART0 IRQ Handler
- * NOTE: This example shows how to save/restore all registers rather than just
- *       those backed up by the exception stack frame. We add extra
- *       push and pop instructions in the assembly routine. 
- *       The actual c_UART0_IRQHandler does the rest of irq handling
- */
-__asm void UART0_IRQHandler(void)
-{
-	PRESERVE8
-	IMPORT c_UART0_IRQHandler
-	PUSH{r4-r11, lr}
-	BL c_UART0_IRQHandler
-	POP{r4-r11, pc}
-} 
-/**
- * @brief: c UART0 IRQ Handler
+ * NOTE: The ISR never switches processes itself, PendSV_Handler does,
+ *       so the exception stack frame is all that needs saving.
  */
-void c_UART0_IRQHandler(void)
+void UART0_IRQHandler(void)
 {
+	const pid_t account_pid = k_account_isr_enter(PID_UART_IPROC);
 	disable_irq();
 	uint8_t IIR_IntId;	    // Interrupt ID from IIR 		 
 	LPC_UART_TypeDef *pUart = (LPC_UART_TypeDef *)LPC_UART0;
@@ -289,16 +291,16 @@ void c_UART0_IRQHandler(void)
 	IIR_IntId = (pUart->IIR) >> 1 ; // skip pending bit in IIR 
 	if (IIR_IntId & IIR_RDA) { // Receive Data Avaialbe
 		/* read UART. Read RBR will clear the interrupt */
-		uint8_t ch = pUart->RBR;		
-		if (!check_hotkey(ch)) {
-			if (ch != 127 && ch != '\b') { // skip backspace
-				// Echo-back before it's processed
-				uart_putc_nonblocking(ch);
-				if (ch == '\r') {
-					uart_putc_nonblocking('\n');
-				}
-				uart_send_input_char(ch);
-			}
+		uint8_t ch = pUart->RBR;		
+		if (!check_hotkey(ch)) {
+			if (ch != 127 && ch != '\b') { // skip backspace
+				// Echo-back before it's processed
+				uart_putc_nonblocking(ch);
+				if (ch == '\r') {
+					uart_putc_nonblocking('\n');
+				}
+				uart_send_input_char(ch);
+			}
 		}
 	} else if (IIR_IntId & IIR_THRE) {
 	/* THRE Interrupt, transmit holding register becomes empty */
@@ -316,6 +318,7 @@ void c_UART0_IRQHandler(void)
 			uart1_put_string("Should not get here!\n\r");
 #endif // DEBUG_0
 	}	
-	enable_irq();
+	enable_irq();
 	k_check_preemption();
+	k_account_isr_exit(account_pid);
 }
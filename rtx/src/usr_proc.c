@@ -1,696 +1,1334 @@
-/**
- * @file:   usr_proc.c
- * @brief:  Two user processes: proc1 and proc2
- * @author: Yiqing Huang
- * @date:   2014/02/28
- * NOTE: Each process is in an infinite loop. Processes never terminate.
- */
-
-#include <assert.h>
-#include <string.h>
-#include <stdio.h>
-#include <stddef.h>
-#include <stdbool.h>
-#include <stdlib.h>
-#include "rtx.h"
-#include "common.h"
-#include "k_process.h"
-#include "k_cycle_count.h"
-#include "usr_proc.h"
-#include "printf.h"
-#include "list.h"
-
-#ifdef HAS_TIMESLICING
-#define NUM_TESTS 122
-#else
-// Test FIFO ordering
-#define NUM_TESTS 147
-#endif
-#define GROUP_ID "004"
-
-#define test_printf(...) printf("G" GROUP_ID "_test: " __VA_ARGS__)
-
-/* initialization table item */
-PROC_INIT g_test_procs[NUM_TEST_PROCS];
-static volatile int proc2_work_remaining = 3, proc3_work_remaining = 3, finished_proc = 0, finished = 0;
-static int tests_ran = 0, tests_failed = 0;
-const char *test_state = "Starting tests";
-
-static void infinite_loop(void)
-{
-	for (;;) {
-		release_processor();
-	}
-}
-
-#ifdef LOW_MEM
-void test_assert(int expected, int lineno) {
-	const char *msg = "See usr_proc.c";
-#else
-void test_assert(int expected, const char *msg, int lineno) {
-#endif
-	if (finished) {
-		infinite_loop();
-	}
-	const char *status = expected ? "OK" : "FAIL";
-	if (!expected) {
-		++tests_failed;
-		#ifdef DEBUG_0
-			printf("Assertion failed in %s:%d: %s\n", __FILE__, lineno, msg);
-		#endif
-	}
-	test_printf("test %d %s\n", ++tests_ran, status);
-}
-
-#ifdef LOW_MEM
-#define TEST_ASSERT(expected) \
-	test_assert(!!(expected), __LINE__) \
-
-#else
-#define TEST_ASSERT(expected) \
-	test_assert(!!(expected), #expected, __LINE__); \
-
-#endif
-
-#define TEST_EXPECT(expected, actual) TEST_ASSERT((expected) == (actual));
-
-static int test_release_processor_impl(const char *procname) {
-	printf("Unscheduling %s\n", procname);
-	int ret = release_processor();
-	if (finished) {
-		infinite_loop();
-	}
-	printf("Rescheduling %s\n", procname);
-	return ret;
-}
-#define test_release_processor() test_release_processor_impl(__FUNCTION__)
-void set_test_procs() {
-	int i;
-	for( i = 0; i < NUM_TEST_PROCS; i++ ) {
-		g_test_procs[i].m_pid=(U32)(i+1);
-		g_test_procs[i].m_priority=LOWEST;
-		g_test_procs[i].m_stack_size=0x200;
-	}
-  
-	g_test_procs[0].mpf_start_pc = &proc1;
-	g_test_procs[1].mpf_start_pc = &proc2;
-	g_test_procs[2].mpf_start_pc = &proc3;
-	g_test_procs[3].mpf_start_pc = &proc4;
-	g_test_procs[4].mpf_start_pc = &proc5;
-	g_test_procs[5].mpf_start_pc = &proc6;
-	g_test_procs[6].mpf_start_pc = &proc_A;
-	g_test_procs[7].mpf_start_pc = &proc_B;
-	g_test_procs[8].mpf_start_pc = &proc_C;
-}
-
-static void test_transition_impl(const char *from, const char *to, int lineno)
-{
-	disable_irq();
-	// Silently allow for non-FIFO ordering, up to MAX_YIELDS times
-#ifdef HAS_TIMESLICING
-#define MAX_YIELDS (NUM_PROCS * 2)
-#else
-#define MAX_YIELDS (0)
-#endif
-	const char *const initial_test_state = test_state;
-	const char *prev_test_state = test_state;
-	int yields = 0;
-	for (int i = 0; i < MAX_YIELDS && test_state != from; ++i) {
-		enable_irq();
-		++yields;
-		release_processor();
-		disable_irq();
-		if (prev_test_state != test_state) {
-			prev_test_state = test_state;
-			i = 0;
-		}
-	}
-#ifdef DEBUG_0
-	if (from != test_state) {
-		printf(
-			"test_transition(%s, %s)\n  expected state %s, but\n  got %s (%s after %d yields)\n",
-			from,
-			to,
-			from,
-			initial_test_state,
-			test_state,
-			yields
-		);
-		assert(0);
-	}
-#endif
-#ifdef LOW_MEM
-	test_assert(from == test_state, lineno);
-#else
-	test_assert(from == test_state, "from == test_state (OS scheduled wrong process)", lineno);
-#endif
-	printf("Done: %s, starting: %s at %s:%d\n", test_state, to, __FILE__, lineno);
-	test_state = to;
-	enable_irq();
-}
-#define test_transition(from, to) test_transition_impl((from), (to), __LINE__)
-
-typedef struct mem_block {
-	struct mem_block *volatile next;
-	volatile char data[128 - sizeof(struct mem_block *)];
-} mem_block_t;
-mem_block_t *volatile test_mem_front = NULL;
-char test_mem_blocks = 0;
-// Count this as a single test
-int changed_bytes = 0;
-
-static void test_mem_release(void) {
-	assert(test_mem_front != NULL);
-	mem_block_t *cur = test_mem_front;
-	test_mem_front = cur->next;
-
-	for (int i = 0; i < sizeof(cur->data); ++i) {
-		if (cur->data[i] != i + test_mem_blocks) {
-			++changed_bytes;
-		}
-	}
-	--test_mem_blocks;
-
-	printf("Releasing mem block 0x%08x\n", (unsigned long) cur);
-	TEST_EXPECT(0, release_memory_block(cur));
-}
-
-static void *test_mem_request(void) {
-	mem_block_t *cur = (mem_block_t *)request_memory_block();
-	printf("Requested mem block 0x%08x\n", (unsigned long) cur);
-	assert(sizeof(*cur) == 128);
-
-	++test_mem_blocks;
-	for (int i = 0; i < sizeof(cur->data); ++i) {
-		cur->data[i] = i + test_mem_blocks;
-	}
-
-	cur->next = test_mem_front;
-	test_mem_front = cur;
-	return (void *) cur->data;
-}
-
-static int test_set_process_priority(int pid, int prio) {
-	printf("Setting process %d prio to %d\n", pid, prio);
-	return set_process_priority(pid, prio);
-}
-
-static int test_get_process_priority(int pid) {
-	const int prio = get_process_priority(pid);
-	printf("Process %d has prio %d\n", pid, prio);
-	return prio;
-}
-
-#define TEST_TIME(stmt) do {\
-	unsigned before = get_cycle_count24();\
-	stmt;\
-	unsigned after = get_cycle_count24();\
-	printf(\
-		"%s: \"%s\" took %u cycles at %u Hz\n",\
-		__FUNCTION__,\
-		#stmt,\
-		cycle_count_difference(before, after),\
-		__CORE_CLK\
-	);\
-} while (0)
-
-static void test_time_primitives(int caller_pid) {
-	const int iterations = 3;
-	printf("Testing primitives, running %d iterations\n", iterations);
-	for (int iteration = 0; iteration < iterations; ++iteration) {
-		// Test doing nothing
-		TEST_TIME();
-
-		// Test request_memory_block
-		MSG_BUF *p;
-		TEST_TIME(p = request_memory_block());
-
-		// Test send_message
-		p->mtype = DEFAULT;
-		TEST_TIME(send_message(caller_pid, p));
-		
-		// Test receive_message
-		int sender = -1;
-		MSG_BUF *q;
-		TEST_TIME(q = receive_message(&sender));
-		assert(p == q);
-		
-		release_memory_block(p);
-		p = q = NULL;
-	}
-}
-
-#define MIN_MEM_BLOCKS 5
-
-/**
- * @brief: a process that tests the RTX API
- */
-void proc1(void)
-{
-	test_printf("START\n");
-	test_printf("total %d tests\n", NUM_TESTS);
-
-#ifdef HAS_TIMESLICING
-	test_transition(test_state, "Memory blocking");
-	test_set_process_priority(PID_P1, LOW);
-	// Due to preemption, we can't tell whether we're blocked.
-	// Try to allocate a few blocks.
-	while (test_state == "Memory blocking") {
-		test_mem_request();
-	}
-
-	// We should have been unblocked
-	test_transition("Memory unblocked", "Get prio");
-#else
-	// int test_release_processor();
-	// This primitive transfers the control to the RTX (the calling process voluntarily releases
-	// the processor). The invoking process remains ready to execute and is put at the end of the
-	// ready queue of the same priority. Another process may possibly be selected for execution.
-	test_transition(test_state, "FIFO scheduling");
-	assert(proc2_work_remaining == 3);
-	for (int i = 2; i >= 0; --i) {
-		TEST_EXPECT(0, test_release_processor());
-		TEST_EXPECT(i, proc2_work_remaining);
-		TEST_EXPECT(i, proc3_work_remaining);
-	}
-
-	test_transition("FIFO scheduling", "Equal prio mem blocking");
-	while (test_state == "Equal prio mem blocking") {
-		test_mem_request();
-	}
-
-	// We should have been unblocked
-	test_transition("Equal prio mem unblocked", "Get prio");
-#endif
-	TEST_EXPECT(LOWEST, test_get_process_priority(PID_P1));
-	TEST_EXPECT(LOWEST, test_get_process_priority(PID_P2));
-	TEST_EXPECT(RTX_ERR, test_get_process_priority(-1));
-	TEST_EXPECT(RTX_ERR, test_get_process_priority(MAX_PID + 1));
-	TEST_EXPECT(4, test_get_process_priority(PID_NULL));
-
-	test_transition("Get prio", "Set null prio");
-	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_NULL, -1));
-	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_NULL, 0));
-	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_NULL, 3));
-	TEST_EXPECT(0, test_set_process_priority(PID_NULL, 4));
-
-	test_transition("Set null prio", "Set user prio (no-op)");
-	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_P1, -1));
-	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_P1, 4));
-	TEST_EXPECT(0, test_set_process_priority(PID_P1, test_get_process_priority(PID_P1)));
-	TEST_EXPECT(0, test_set_process_priority(PID_P2, test_get_process_priority(PID_P2)));
-
-	test_transition("Set user prio (no-op)", "Set user prio (higher)");
-	TEST_EXPECT(0, test_set_process_priority(PID_P2, MEDIUM));
-
-#ifdef HAS_TIMESLICING
-	test_transition("Set user prio (inversion)", "Preempt (inversion)");
-#else
-	test_transition("Set user prio (inversion 2)", "Preempt (inversion)");
-#endif
-	TEST_EXPECT(0, test_set_process_priority(PID_P2, HIGH));
-	test_mem_release();
-
-	test_transition("Set user prio (lower)", "Release processor (max prio)");
-	// We're prio LOW, so we should still run.
-	TEST_EXPECT(0, test_release_processor());
-
-	test_transition("Release processor (max prio)", "Resource contention (1 blocked)");
-	test_mem_request();
-
-	test_transition("Resource contention resolved", "Count blocks");
-	int blocks = 0;
-	while (test_mem_front != NULL) {
-		test_mem_release();
-		++blocks;
-	}
-	TEST_ASSERT(blocks >= 5);
-
-	test_transition("Count blocks", "Send self msg");
-	{
-		char msg_buf[128];
-		struct msgbuf *msg = (struct msgbuf *)msg_buf;
-		msg->mtype = DEFAULT;
-		strcpy(msg->mtext, "Hi");
-		TEST_EXPECT(0, !send_message(-1, msg));
-		TEST_EXPECT(0, delayed_send(PID_P1, msg, 0));
-
-		{
-			int from = -1;
-			struct msgbuf *m1 = receive_message(&from);
-			TEST_EXPECT(PID_P1, from);
-			TEST_EXPECT(msg, m1);
-			TEST_ASSERT(!strcmp("Hi", m1->mtext));
-		}
-
-		{
-			TEST_EXPECT(0, send_message(PID_P1, msg));
-			struct msgbuf *m2 = receive_message(NULL);
-			TEST_ASSERT(!strcmp("Hi", m2->mtext));
-		}
-	}
-
-	test_transition("Send self msg", "Send other msg");
-	test_set_process_priority(PID_P2, HIGH);
-	test_set_process_priority(PID_P3, HIGH);
-	test_transition("Send other msg (2 and 3 blocked)", "Recv other msg (2 and 3 blocked)");
-	for (int i = 0; i < 2; ++i) {
-		const static int pids[2] = {PID_P2, PID_P3};
-		struct msgbuf *msg = (struct msgbuf *)request_memory_block();
-		msg->mtype = 42;
-		strcpy(msg->mtext, "42");
-		TEST_EXPECT(0, send_message(pids[i], msg));
-	}
-
-	test_release_processor();
-	test_transition("Send delayed msg", "Recv delayed msg");
-	for (int i = 0; i < 3; ++i) {
-		int from = -1;
-		struct msgbuf *msg = receive_message(&from);
-		TEST_EXPECT(PID_P2, from);
-		TEST_EXPECT(10 + i, msg->mtype);
-		char buf[MTEXT_MAXLEN + 1];
-		snprintf(buf, MTEXT_MAXLEN, "%d", i);
-		TEST_ASSERT(!strncmp(buf, msg->mtext, MTEXT_MAXLEN));
-	}
-
-	test_transition("Recv delayed msg", "Tests done");
-
-	TEST_EXPECT(0, changed_bytes);
-	TEST_ASSERT(finished_proc >= 2);
-	while (finished_proc < 2) {
-		test_release_processor();
-	}
-
-	test_printf("%d/%d tests OK\n", tests_ran - tests_failed, tests_ran);
-	test_printf("%d/%d tests FAIL\n", tests_failed, tests_ran);
-	// This invalidates tests_ran, but since all processes have reached
-	//   infinite_loop(), everything is okay.
-	assert(NUM_TESTS == tests_ran);
-	test_printf("END\n");
-	finished = 1;
-	
-	test_time_primitives(PID_P1);
-	infinite_loop();
-}
-
-static void test_receive_42_from_proc1(void)
-{
-	int from = -1;
-	struct msgbuf *msg = receive_message(&from);
-	TEST_EXPECT(PID_P1, from);
-	TEST_EXPECT(42, msg->mtype);
-	TEST_ASSERT(!strcmp("42", msg->mtext));
-	release_memory_block(msg);
-}
-
-/**
- * @brief: a helper process to proc1
- */
-void proc2(void)
-{
-	printf("Started %s\n", __FUNCTION__);
-#ifdef HAS_TIMESLICING
-	test_transition("Memory blocking", "Memory blocked");
-	test_set_process_priority(PID_P1, LOWEST);
-
-	// Let's free enough memory
-	test_mem_release();
-	test_mem_release();
-	test_transition("Memory blocked", "Memory unblocked");
-
-	test_transition("Set user prio (higher)", "Set user prio (inversion)");
-	for (int i = 0; i < 30 && test_state == "Set user prio (inversion)"; ++i) {
-		test_mem_request();
-	}
-#else
-	while (proc2_work_remaining > 0) {
-		TEST_EXPECT(proc3_work_remaining, proc2_work_remaining);
-		--proc2_work_remaining;
-		TEST_EXPECT(0, test_release_processor());
-	}
-	test_transition("Equal prio mem blocking", "Equal prio mem unblocking");
-
-	// Let's free enough memory
-	test_mem_release();
-	test_mem_release();
-
-	test_transition("Equal prio mem unblocking", "Equal prio mem unblocking 2");
-	// Should schedule proc3 since proc1 was preempted recently
-	TEST_EXPECT(0, test_release_processor());
-
-	test_transition("Set user prio (higher)", "Set user prio (inversion)");
-	for (int i = 0; i < 3 && test_state == "Set user prio (inversion)"; ++i) {
-		test_mem_request();
-	}
-#endif
-
-	test_transition("Preempt (inversion)", "Set prio preempt (failed)");
-	TEST_EXPECT(0, test_set_process_priority(PID_P1, LOW));
-	TEST_EXPECT(0, test_set_process_priority(PID_P2, MEDIUM));
-
-	test_transition("Set prio preempt (failed)", "Set user prio (lower, tied)");
-	TEST_EXPECT(0, test_set_process_priority(PID_P2, LOW));
-
-	test_transition("Set user prio (lower, tied)", "Set user prio (lower)");
-	// Move ourselves after proc3 in the ready queue
-	TEST_EXPECT(0, test_set_process_priority(PID_P2, LOWEST));
-
-	test_transition("Resource contention (1 and 3 blocked)", "Resource contention (3 and 1 blocked)");
-	TEST_EXPECT(0, test_set_process_priority(PID_P3, HIGH));
-	TEST_EXPECT(0, test_set_process_priority(PID_P1, LOWEST));
-	TEST_EXPECT(0, test_set_process_priority(PID_P2, LOWEST));
-	test_mem_release();
-
-	test_transition("Send other msg", "Send other msg (2 blocked)");
-	TEST_EXPECT(HIGH, test_get_process_priority(PID_P2));
-	test_receive_42_from_proc1();
-	test_transition("Recv other msg (2 and 3 blocked)", "Recv other msg (3 blocked)");
-	TEST_EXPECT(0, test_set_process_priority(PID_P2, LOWEST));
-	release_processor(); // Go to proc2
-
-	test_transition("Recv other msg (done)", "Send delayed msg");
-	for (int i = 2; i >= 0; --i) {
-		struct msgbuf *msg = (struct msgbuf *)request_memory_block();
-		msg->mtype = 10 + i;
-		sprintf(msg->mtext, "%d", i);
-		TEST_EXPECT(0, delayed_send(PID_P1, msg, i * 100));
-	}
-
-	++finished_proc;
-
-	infinite_loop();
-}
-
-/**
- * A second helper process.
- */
-void proc3(void)
-{
-	printf("Started %s\n", __FUNCTION__);
-#ifndef HAS_TIMESLICING
-	while (proc3_work_remaining > 0) {
-		--proc3_work_remaining;
-		TEST_EXPECT(proc2_work_remaining, proc3_work_remaining);
-		TEST_EXPECT(0, test_release_processor());
-	}
-
-	// Since proc1 was preempted, it's at the back of the ready queue
-	// Let's run it.
-	test_transition("Equal prio mem unblocking 2", "Equal prio mem unblocked");
-	test_release_processor();
-
-	test_transition("Set user prio (inversion)", "Set user prio (inversion 2)");
-	test_release_processor();
-#endif
-
-	test_transition("Resource contention (1 blocked)", "Resource contention (1 and 3 blocked)");
-	test_mem_request();
-
-	test_transition("Resource contention (3 and 1 blocked)", "Resource contention (1 blocked again)");
-	test_mem_release();
-
-	test_transition("Resource contention (1 blocked again)", "Resource contention resolved");
-	TEST_EXPECT(0, test_set_process_priority(PID_P3, LOWEST));
-	release_processor(); // Go back to proc1
-
-	test_transition("Send other msg (2 blocked)", "Send other msg (2 and 3 blocked)");
-	TEST_EXPECT(HIGH, test_get_process_priority(PID_P2));
-	test_receive_42_from_proc1();
-	test_transition("Recv other msg (3 blocked)", "Recv other msg (done)");
-	TEST_EXPECT(0, test_set_process_priority(PID_P3, LOWEST));
-
-	++finished_proc;
-	TEST_EXPECT(0, test_release_processor());
-
-	infinite_loop();
-}
-
-// Process to show blocked on receive state hotkey
-void proc4(void)
-{
-	for (;;) {
-		receive_message(NULL);
-	}
-}
-
-// Process to show ready state hotkey
-void proc5(void)
-{
-	infinite_loop();
-}
-
-// Process to show blocked on memory hotkey
-void proc6(void)
-{
-	for (;;) {
-		infinite_loop();
-	}
-}
-
-/********************* Stress Test Procs ***********************/
-void proc_A(void)
-{
-	// Process A:
-	// p <- request_memory_block
-  // register with Command Decoder as handler of %Z commands
-	struct msgbuf *p_msg_env = (struct msgbuf *)request_memory_block();
-	p_msg_env->mtype = KCD_REG;
-	strcpy(p_msg_env->mtext, "%Z");
-	send_message(PID_KCD, p_msg_env);
-
-	for (;;) {
-		// p <- receive a message
-		// if the message(p) contains the %Z command then
-		//   release_memory_block(p)
-		//   exit the loop
-		// else
-		//   release_memory_block(p)
-		// endif
-		p_msg_env = receive_message(NULL);
-		if(strstr(p_msg_env->mtext, "%Z") != NULL) {
-			release_memory_block(p_msg_env);
-			break;
-		} else {
-			release_memory_block(p_msg_env);
-		}
-	}
-	printf("Got command %Z\n");
-	// Second loop:
-	// num = 0
-	int num = 0;
-	for (;;) {
-		// p <- request memory block to be used as a message envelope
-		// set message_type field of p to count_report
-		// set msg_data[0] field of p to num
-		// send the message(p) to process B
-		// num = num + 1
-		// release_processor()
-		p_msg_env = (struct msgbuf *)request_memory_block();
-		p_msg_env->mtype = COUNT_REPORT;
-		_sprintf(p_msg_env->mtext, "%d", num);
-		printf("proc_A sending message #%d\n", num);
-		send_message(PID_B, p_msg_env);
-		printf("proc_A sent message #%d\n", num);
-		num++;
-		release_processor();
-	}
-	// note that Process A does not de-allocate
-	// any received envelopes in the second loop
-}
-
-void proc_B(void)
-{
-	// loop forever
-	// receive a message
-	// send the message to process C
-	// endloop
-	for (;;) {
-		struct msgbuf *msg = receive_message(NULL);
-		printf("proc_B sending message to proc_C: %s\n", msg->mtext);
-		send_message(PID_C, msg);
-	}
-}
-
-LL_DECLARE(static c_message_queue, MSG_BUF *, NUM_MEM_BLOCKS + 2);
-
-/**
- * Hibernate for 10 seconds.
- * Takes a message envelope (memory block) q and sends it to itself.
- * `hibernate` returns after the message has been received again.
- * Does not free `q`.
- * Note: hibernate changes the message mtype
- */
-static void hibernate(MSG_BUF *q) {
-	// request a delayed_send for 10 sec delay with msg_type=wakeup10 using q
-	q->mtype = WAKEUP_10;
-	delayed_send(PID_C, q, 10000);
-
-	// loop forever
-	// p <- receive a message //block and let other processes execute
-	//   if (message_type of p == wakeup10) then
-	//     exit this loop
-	//   else
-	//     put message (p) on the local message queue for later processing
-	//   endif
-	// endloop
-	for (;;) {
-		struct msgbuf* p = (struct msgbuf*)receive_message(NULL);
-		if(p->mtype == WAKEUP_10) {
-			assert(p == q);
-			break;
-		} else {
-			LL_PUSH_BACK(c_message_queue, p);
-		}
-	}
-}
-
-void proc_C(void) {
-	// perform any needed initialization and create a local message queue
-	// If process A has higher priority, then we could be out of
-	//   memory blocks right now. So, we can't request memory here.
-	bool hibernate_for_10_sec = false;
-
-	for(;;) {
-		struct msgbuf* msg = NULL;
-		// if (local message queue is empty) then
-		//  	p <- receive a message
-		// else
-		//	 p <- dequeue the first message from the local message queue
-		// endif
-		if (LL_SIZE(c_message_queue) == 0) {
-			msg = receive_message(NULL);	
-		} else {
-			msg = LL_POP_FRONT(c_message_queue);
-		}
-
-		// if msg_type of p == count_report then
-		//   if msg_data[0] of p is evenly divisible by 20 then
-		//     send "Process C" to CRT display using msg envelope p
-		//     hibernate for 10 sec
-		//   endif
-		// endif
-		if (msg->mtype == COUNT_REPORT) {
-			int count = atoi(msg->mtext);
-
-			if (hibernate_for_10_sec) {
-				hibernate_for_10_sec = false;
-				hibernate(msg);
-			}
-
-			if (count % 20 == 0) {
-				msg->mtype = CRT_DISPLAY;
-				strcpy(msg->mtext, "Process C\n");
-				send_message(PID_CRT, msg);
-				msg = NULL;
-
-				hibernate_for_10_sec = true;
-				// Don't free the memory block, since it's set
-				continue;
-			}
+/**
+ * @file:   usr_proc.c
+ * @brief:  Two user processes: proc1 and proc2
+ * @author: Yiqing Huang
+ * @date:   2014/02/28
+ * NOTE: Each process is in an infinite loop. Only the workers that
+ *       test_create_exit_process creates terminate.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "rtx.h"
+#include "common.h"
+#include "k_process.h"
+#include "k_cycle_count.h"
+#include "usr_proc.h"
+#include "printf.h"
+#include "list.h"
+#include "priority_queue.h"
+#include "bitmap_queue.h"
+#include "timer_wheel.h"
+
+#ifdef HAS_TIMESLICING
+#define NUM_TESTS 263
+#else
+// Test FIFO ordering
+#define NUM_TESTS 288
+#endif
+#define GROUP_ID "004"
+
+#define test_printf(...) printf("G" GROUP_ID "_test: " __VA_ARGS__)
+
+/* initialization table item */
+PROC_INIT g_test_procs[NUM_TEST_PROCS];
+static volatile int proc2_work_remaining = 3, proc3_work_remaining = 3, finished_proc = 0, finished = 0;
+static int tests_ran = 0, tests_failed = 0;
+const char *test_state = "Starting tests";
+
+static void infinite_loop(void)
+{
+	for (;;) {
+		release_processor();
+	}
+}
+
+#ifdef LOW_MEM
+void test_assert(int expected, int lineno) {
+	const char *msg = "See usr_proc.c";
+#else
+void test_assert(int expected, const char *msg, int lineno) {
+#endif
+	if (finished) {
+		infinite_loop();
+	}
+	const char *status = expected ? "OK" : "FAIL";
+	if (!expected) {
+		++tests_failed;
+		#ifdef DEBUG_0
+			printf("Assertion failed in %s:%d: %s\n", __FILE__, lineno, msg);
+		#endif
+	}
+	test_printf("test %d %s\n", ++tests_ran, status);
+}
+
+#ifdef LOW_MEM
+#define TEST_ASSERT(expected) \
+	test_assert(!!(expected), __LINE__) \
+
+#else
+#define TEST_ASSERT(expected) \
+	test_assert(!!(expected), #expected, __LINE__); \
+
+#endif
+
+#define TEST_EXPECT(expected, actual) TEST_ASSERT((expected) == (actual));
+
+static int test_release_processor_impl(const char *procname) {
+	printf("Unscheduling %s\n", procname);
+	int ret = release_processor();
+	if (finished) {
+		infinite_loop();
+	}
+	printf("Rescheduling %s\n", procname);
+	return ret;
+}
+#define test_release_processor() test_release_processor_impl(__FUNCTION__)
+void set_test_procs() {
+	int i;
+	for( i = 0; i < NUM_TEST_PROCS; i++ ) {
+		g_test_procs[i].m_pid=(U32)(i+1);
+		g_test_procs[i].m_priority=LOWEST;
+		g_test_procs[i].m_stack_size=USR_SZ_STACK;
+	}
+  
+	g_test_procs[0].mpf_start_pc = &proc1;
+	g_test_procs[1].mpf_start_pc = &proc2;
+	g_test_procs[2].mpf_start_pc = &proc3;
+	g_test_procs[3].mpf_start_pc = &proc4;
+	g_test_procs[4].mpf_start_pc = &proc5;
+	g_test_procs[5].mpf_start_pc = &proc6;
+	g_test_procs[6].mpf_start_pc = &proc_A;
+	g_test_procs[7].mpf_start_pc = &proc_B;
+	g_test_procs[8].mpf_start_pc = &proc_C;
+}
+
+static void test_transition_impl(const char *from, const char *to, int lineno)
+{
+	disable_irq();
+	// Silently allow for non-FIFO ordering, up to MAX_YIELDS times
+#ifdef HAS_TIMESLICING
+#define MAX_YIELDS (NUM_PROCS * 2)
+#else
+#define MAX_YIELDS (0)
+#endif
+	const char *const initial_test_state = test_state;
+	const char *prev_test_state = test_state;
+	int yields = 0;
+	for (int i = 0; i < MAX_YIELDS && test_state != from; ++i) {
+		enable_irq();
+		++yields;
+		release_processor();
+		disable_irq();
+		if (prev_test_state != test_state) {
+			prev_test_state = test_state;
+			i = 0;
 		}
-		
-		release_memory_block(msg);
-		release_processor();
-	}
-}
+	}
+#ifdef DEBUG_0
+	if (from != test_state) {
+		printf(
+			"test_transition(%s, %s)\n  expected state %s, but\n  got %s (%s after %d yields)\n",
+			from,
+			to,
+			from,
+			initial_test_state,
+			test_state,
+			yields
+		);
+		assert(0);
+	}
+#endif
+#ifdef LOW_MEM
+	test_assert(from == test_state, lineno);
+#else
+	test_assert(from == test_state, "from == test_state (OS scheduled wrong process)", lineno);
+#endif
+	printf("Done: %s, starting: %s at %s:%d\n", test_state, to, __FILE__, lineno);
+	test_state = to;
+	enable_irq();
+}
+#define test_transition(from, to) test_transition_impl((from), (to), __LINE__)
+
+typedef struct mem_block {
+	struct mem_block *volatile next;
+	volatile char data[128 - sizeof(struct mem_block *)];
+} mem_block_t;
+mem_block_t *volatile test_mem_front = NULL;
+char test_mem_blocks = 0;
+// Count this as a single test
+int changed_bytes = 0;
+
+static void test_mem_release(void) {
+	assert(test_mem_front != NULL);
+	mem_block_t *cur = test_mem_front;
+	test_mem_front = cur->next;
+
+	for (int i = 0; i < sizeof(cur->data); ++i) {
+		if (cur->data[i] != i + test_mem_blocks) {
+			++changed_bytes;
+		}
+	}
+	--test_mem_blocks;
+
+	printf("Releasing mem block 0x%08x\n", (unsigned long) cur);
+	TEST_EXPECT(0, release_memory_block(cur));
+}
+
+static void *test_mem_request(void) {
+	mem_block_t *cur = (mem_block_t *)request_memory_block();
+	printf("Requested mem block 0x%08x\n", (unsigned long) cur);
+	assert(sizeof(*cur) == 128);
+
+	++test_mem_blocks;
+	for (int i = 0; i < sizeof(cur->data); ++i) {
+		cur->data[i] = i + test_mem_blocks;
+	}
+
+	cur->next = test_mem_front;
+	test_mem_front = cur;
+	return (void *) cur->data;
+}
+
+static int test_set_process_priority(int pid, int prio) {
+	printf("Setting process %d prio to %d\n", pid, prio);
+	return set_process_priority(pid, prio);
+}
+
+static int test_get_process_priority(int pid) {
+	const int prio = get_process_priority(pid);
+	printf("Process %d has prio %d\n", pid, prio);
+	return prio;
+}
+
+#define TEST_TIME(stmt) do {\
+	unsigned before = get_cycle_count24();\
+	stmt;\
+	unsigned after = get_cycle_count24();\
+	printf(\
+		"%s: \"%s\" took %u cycles at %u Hz\n",\
+		__FUNCTION__,\
+		#stmt,\
+		cycle_count_difference(before, after),\
+		__CORE_CLK\
+	);\
+} while (0)
+
+static void test_time_primitives(int caller_pid) {
+	const int iterations = 3;
+	printf("Testing primitives, running %d iterations\n", iterations);
+	for (int iteration = 0; iteration < iterations; ++iteration) {
+		// Test doing nothing
+		TEST_TIME();
+
+		// Test a yield, through PendSV, and back
+		TEST_TIME(release_processor());
+
+		// Test the system call latency, on the fast path that can't block
+		int prio;
+		TEST_TIME(prio = get_process_priority(caller_pid));
+		TEST_ASSERT(prio != RTX_ERR);
+
+		// Test an unknown pid, which also never enters the scheduler
+		TEST_TIME(prio = get_process_priority(MAX_PID + 1));
+		TEST_EXPECT(RTX_ERR, prio);
+
+		// Test request_memory_block
+		MSG_BUF *p;
+		TEST_TIME(p = request_memory_block());
+
+		// Test send_message
+		p->mtype = DEFAULT;
+		TEST_TIME(send_message(caller_pid, p));
+		
+		// Test receive_message
+		int sender = -1;
+		MSG_BUF *q;
+		TEST_TIME(q = receive_message(&sender));
+		TEST_EXPECT(p, q);
+		
+		release_memory_block(p);
+		p = q = NULL;
+	}
+}
+
+static volatile int worker_runs = 0;
+
+// Exits by returning, still holding a memory block and an unread message
+static void test_worker(void)
+{
+	MSG_BUF *msg = request_memory_block();
+	msg->mtype = DEFAULT;
+	++worker_runs;
+}
+
+// Fill the pool of dynamic processes over and over. This runs out of memory
+// unless exit reclaims the workers' blocks and mailboxes, and out of pids
+// and stacks unless those are reused too.
+static void test_create_exit_process(void)
+{
+	const int rounds = MAX_MEM_BLOCKS / NUM_DYNAMIC_PROCS + 1;
+	printf("Testing create_process and exit_process, running %d rounds\n", rounds);
+	int ret;
+	// The workers run when we yield
+	set_process_priority(PID_P1, LOWEST);
+	ret = create_process(NULL, LOWEST, USR_SZ_STACK);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = create_process(&test_worker, NULL_PRIO, USR_SZ_STACK);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = create_process(&test_worker, LOWEST, USR_SZ_STACK + 8);
+	TEST_EXPECT(RTX_ERR, ret);
+	// Too small for its initial context and guard
+	ret = create_process(&test_worker, LOWEST, 0);
+	TEST_EXPECT(RTX_ERR, ret);
+
+	// The number of rounds depends on the heap, so they're one test
+	bool rounds_ok = true;
+	for (int round = 0; round < rounds; ++round) {
+		int pids[NUM_DYNAMIC_PROCS];
+		for (int i = 0; i < NUM_DYNAMIC_PROCS; ++i) {
+			pids[i] = create_process(&test_worker, LOWEST, USR_SZ_STACK);
+			if (pids[i] <= MAX_PID || get_process_priority(pids[i]) != LOWEST) {
+				rounds_ok = false;
+			}
+			MSG_BUF *msg = request_memory_block();
+			msg->mtype = DEFAULT;
+			ret = send_message(pids[i], msg);
+			if (ret != RTX_OK) {
+				release_memory_block(msg);
+				rounds_ok = false;
+			}
+		}
+		ret = create_process(&test_worker, LOWEST, USR_SZ_STACK);
+		if (ret != RTX_ERR) {
+			rounds_ok = false;
+		}
+
+		for (int i = 0; i < NUM_DYNAMIC_PROCS; ++i) {
+			while (get_process_priority(pids[i]) != RTX_ERR) {
+				release_processor();
+			}
+			ret = send_message(pids[i], &pids);
+			if (ret != RTX_ERR) {
+				rounds_ok = false;
+			}
+		}
+	}
+	TEST_ASSERT(rounds_ok);
+	TEST_EXPECT(rounds * NUM_DYNAMIC_PROCS, worker_runs);
+	printf("create_process and exit_process done\n");
+}
+
+// Compare the linear-list priority queue with the bitmap queue behind g_ready_queue.
+// Every test process is queued at LOWEST, which is the worst case for the scan.
+static void test_time_ready_queue(void) {
+	LL_DECLARE(static old_queue[NUM_PRIORITIES], pid_t, NUM_PROCS);
+	static bitmap_queue_t new_queue;
+	pid_t pid;
+	int prio;
+
+	printf("Timing ready queue, %d processes\n", NUM_TEST_PROCS);
+	for (int i = 0; i < NUM_TEST_PROCS; ++i) {
+		TEST_TIME(push_process(old_queue, g_test_procs[i].m_pid, LOWEST));
+		TEST_TIME(bq_push_back(&new_queue, g_test_procs[i].m_pid, LOWEST));
+	}
+	TEST_TIME(pid = peek_front(old_queue, &prio));
+	TEST_TIME(pid = bq_peek_front(&new_queue, &prio));
+	for (int i = 0; i < NUM_TEST_PROCS; ++i) {
+		TEST_TIME(pid = pop_first_process(old_queue));
+		TEST_TIME(pid = bq_pop_front(&new_queue, &prio));
+	}
+	(void)pid;
+}
+
+#define TW_BENCH_TIMERS 200
+
+static int tw_bench_expired = 0;
+
+static void tw_bench_expire(timer_node_t *node) {
+	++tw_bench_expired;
+}
+
+// Time the delayed message wheel with hundreds of timers outstanding, far more
+// than there are memory blocks. Adding the last costs the same as the first.
+static void test_time_timer_wheel(void) {
+	static timer_wheel_t wheel;
+	static timer_node_t timers[TW_BENCH_TIMERS];
+	U32 deadline;
+	bool pending;
+	int expired;
+
+	printf("Timing timer wheel, %d timers\n", TW_BENCH_TIMERS);
+	for (int i = 0; i < TW_BENCH_TIMERS; ++i) {
+		timers[i].mpf_expire = &tw_bench_expire;
+	}
+	TEST_TIME(tw_add(&wheel, &timers[0], 0, 1000));
+	for (int i = 1; i < TW_BENCH_TIMERS - 1; ++i) {
+		tw_add(&wheel, &timers[i], 0, 1 + (i * 37) % 1000);
+	}
+	TEST_TIME(tw_add(&wheel, &timers[TW_BENCH_TIMERS - 1], 0, 999));
+	TEST_TIME(pending = tw_next_deadline(&wheel, &deadline));
+	// Never later than the last timer added, which is due at 999
+	TEST_ASSERT(pending && deadline <= 999);
+	TEST_TIME(tw_remove(&wheel, &timers[TW_BENCH_TIMERS / 2]));
+	// Expire them all at once, the way proc_timer_i does after a long sleep
+	TEST_TIME(expired = tw_advance(&wheel, 1000));
+	TEST_EXPECT(TW_BENCH_TIMERS - 1, expired);
+	TEST_EXPECT(expired, tw_bench_expired);
+	TEST_ASSERT(tw_is_empty(&wheel));
+}
+
+// Delayed messages to ourselves, taken back or moved before they arrive
+static void test_cancel_delayed_send(void)
+{
+	MSG_BUF *a = request_memory_block(), *b = request_memory_block(), *c = request_memory_block();
+	MSG_BUF *got;
+	int sender = -1;
+	int ret;
+
+	printf("Testing cancel_delayed_send and reschedule_delayed_send\n");
+	a->mtype = b->mtype = c->mtype = DEFAULT;
+	ret = cancel_delayed_send(a);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = reschedule_delayed_send(a, 10);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = delayed_send(PID_P1, a, 50);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = delayed_send(PID_P1, b, 100);
+	TEST_EXPECT(RTX_OK, ret);
+	// It can't be sent twice
+	ret = send_message(PID_P1, a);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = delayed_send(PID_P1, a, 10);
+	TEST_EXPECT(RTX_ERR, ret);
+
+	ret = cancel_delayed_send(a);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = cancel_delayed_send(a);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = reschedule_delayed_send(b, 10);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = delayed_send(PID_P1, c, 100);
+	TEST_EXPECT(RTX_OK, ret);
+	// b comes first now, and a never does
+	got = receive_message(&sender);
+	TEST_EXPECT(b, got);
+	TEST_EXPECT(PID_P1, sender);
+	ret = reschedule_delayed_send(b, 10);
+	TEST_EXPECT(RTX_ERR, ret);
+	got = receive_message(&sender);
+	TEST_EXPECT(c, got);
+	TEST_EXPECT(PID_P1, sender);
+
+	ret = release_memory_block(a);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(b);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(c);
+	TEST_EXPECT(RTX_OK, ret);
+	printf("cancel_delayed_send and reschedule_delayed_send done\n");
+}
+
+// A periodic message to ourselves comes back in the same envelope every period
+static void test_periodic_send(void)
+{
+	MSG_BUF *tick = request_memory_block();
+	MSG_BUF *got;
+	int sender = -1;
+	int ret;
+
+	printf("Testing periodic_send\n");
+	tick->mtype = DEFAULT;
+	ret = periodic_send(PID_P1, tick, 0);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = periodic_send(PID_P1, tick, 20);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = periodic_send(PID_P1, tick, 20);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = send_message(PID_P1, tick);
+	TEST_EXPECT(RTX_ERR, ret);
+	// The kernel still needs it
+	ret = release_memory_block(tick);
+	TEST_EXPECT(RTX_ERR, ret);
+
+	bool ticks_ok = true;
+	for (int i = 0; i < 5; ++i) {
+		got = receive_message(&sender);
+		if (got != tick || sender != PID_P1 || tick->m_kdata[0] < 1) {
+			ticks_ok = false;
+		}
+	}
+	TEST_ASSERT(ticks_ok);
+	ret = reschedule_delayed_send(tick, 50);
+	TEST_EXPECT(RTX_OK, ret);
+	got = receive_message(&sender);
+	TEST_EXPECT(tick, got);
+	ret = cancel_delayed_send(tick);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = cancel_delayed_send(tick);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = release_memory_block(tick);
+	TEST_EXPECT(RTX_OK, ret);
+	printf("periodic_send done\n");
+}
+
+static volatile int sleeper_state = -1;
+
+// Sees what state proc1 is in while it sleeps
+static void test_sleep_watcher(void)
+{
+	PROC_CPU usage;
+	if (get_cpu_usage(PID_P1, &usage) == RTX_OK) {
+		sleeper_state = usage.m_state;
+	}
+}
+
+static void test_sleep(void)
+{
+	MSG_BUF *msg = request_memory_block();
+	MSG_BUF *got;
+	int sender = -1;
+	int ret;
+
+	printf("Testing sleep\n");
+	ret = sleep(-1);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = sleep(0);
+	TEST_EXPECT(RTX_OK, ret);
+
+	// Other processes run while we sleep, and a message that arrives meanwhile waits
+	msg->mtype = DEFAULT;
+	ret = delayed_send(PID_P1, msg, 10);
+	TEST_EXPECT(RTX_OK, ret);
+	const int watcher = create_process(&test_sleep_watcher, get_process_priority(PID_P1), USR_SZ_STACK);
+	TEST_ASSERT(watcher > MAX_PID);
+	int slept = RTX_OK;
+	while (watcher > MAX_PID && sleeper_state == -1 && slept == RTX_OK) {
+		slept = sleep(20);
+	}
+	TEST_EXPECT(RTX_OK, slept);
+	TEST_EXPECT(BLOCKED_ON_TIMER, sleeper_state);
+	got = receive_message(&sender);
+	TEST_EXPECT(msg, got);
+	TEST_EXPECT(PID_P1, sender);
+	release_memory_block(msg);
+	printf("sleep done\n");
+}
+
+static void test_timeouts(void)
+{
+	MSG_BUF *msg = request_memory_block();
+	void *held = NULL, *blk, *got;
+	int sender = -1;
+	int ret;
+	PROC_CPU usage;
+
+	printf("Testing timeouts\n");
+	got = receive_message_timeout(NULL, 0);
+	TEST_EXPECT(NULL, got);
+	got = receive_message_timeout(&sender, 20);
+	TEST_EXPECT(NULL, got);
+
+	// A message that comes in time is received
+	msg->mtype = DEFAULT;
+	ret = delayed_send(PID_P1, msg, 10);
+	TEST_EXPECT(RTX_OK, ret);
+	got = receive_message_timeout(&sender, 1000);
+	TEST_EXPECT(msg, got);
+	TEST_EXPECT(PID_P1, sender);
+	release_memory_block(msg);
+
+	// Starve the pool, each block's first word links it to the next
+	while ((blk = request_memory_block_timeout(0)) != NULL) {
+		*(void **)blk = held;
+		held = blk;
+	}
+	got = request_memory_block_timeout(20);
+	TEST_EXPECT(NULL, got);
+
+	// The timeout took us off the blocked on memory queue, so we aren't handed this
+	blk = held;
+	held = *(void **)blk;
+	release_memory_block(blk);
+	ret = get_cpu_usage(PID_P1, &usage);
+	TEST_EXPECT(RTX_OK, ret);
+	TEST_EXPECT(RUN, usage.m_state);
+	while (held != NULL) {
+		blk = held;
+		held = *(void **)blk;
+		release_memory_block(blk);
+	}
+	printf("timeouts done\n");
+}
+
+static void test_receive_match(void)
+{
+	MSG_BUF *a = request_memory_block(), *b = request_memory_block(), *c = request_memory_block();
+	MSG_BUF *got;
+	int sender = -1;
+	int ret;
+
+	printf("Testing receive_message_match\n");
+	a->mtype = DEFAULT;
+	b->mtype = COUNT_REPORT;
+	c->mtype = KCD_REG;
+	ret = send_message(PID_P1, a);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = send_message(PID_P1, b);
+	TEST_EXPECT(RTX_OK, ret);
+	got = receive_message_match(&sender, PID_ANY, COUNT_REPORT);
+	TEST_EXPECT(b, got);
+	TEST_EXPECT(PID_P1, sender);
+
+	// Blocks past a, which doesn't match, until c arrives
+	ret = delayed_send(PID_P1, c, 10);
+	TEST_EXPECT(RTX_OK, ret);
+	got = receive_message_match(NULL, PID_BIT(PID_P2) | PID_BIT(PID_P1), KCD_REG);
+	TEST_EXPECT(c, got);
+	got = receive_message(NULL);
+	TEST_EXPECT(a, got);
+	release_memory_block(a);
+	release_memory_block(b);
+	release_memory_block(c);
+	printf("receive_message_match done\n");
+}
+
+static void test_receive_batch(void)
+{
+	MSG_BUF *a = request_memory_block(), *b = request_memory_block(), *c = request_memory_block();
+	MSG_BUF *got;
+	void *msgs[2];
+	int senders[2] = {-1, -1};
+	int ret;
+
+	printf("Testing non_blocking_receive_message and receive_messages\n");
+	got = non_blocking_receive_message(NULL);
+	TEST_EXPECT(NULL, got);
+	ret = receive_messages(msgs, NULL, 0);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = send_message(PID_P1, a);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = send_message(PID_P1, b);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = send_message(PID_P1, c);
+	TEST_EXPECT(RTX_OK, ret);
+
+	// At most max, oldest first, and the rest stay queued
+	ret = receive_messages(msgs, senders, 2);
+	TEST_EXPECT(2, ret);
+	TEST_ASSERT(msgs[0] == a && msgs[1] == b);
+	TEST_ASSERT(senders[0] == PID_P1 && senders[1] == PID_P1);
+	got = non_blocking_receive_message(&senders[0]);
+	TEST_EXPECT(c, got);
+	TEST_EXPECT(PID_P1, senders[0]);
+
+	// Blocks until there's one
+	ret = delayed_send(PID_P1, c, 10);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = receive_messages(msgs, NULL, 2);
+	TEST_EXPECT(1, ret);
+	TEST_EXPECT(c, msgs[0]);
+	release_memory_block(a);
+	release_memory_block(b);
+	release_memory_block(c);
+	printf("receive_messages done\n");
+}
+
+static volatile int echo_replied = RTX_ERR;
+
+// Answers one call, with mtype + 1
+static void test_echo_server(void)
+{
+	int caller = -1;
+	MSG_BUF *msg = receive_message(&caller);
+	msg->mtype += 1;
+	echo_replied = reply(caller, msg);
+}
+
+// Exits without answering
+static void test_silent_server(void)
+{
+	receive_message(NULL);
+}
+
+static void test_call_reply(void)
+{
+	MSG_BUF *msg = request_memory_block();
+	MSG_BUF *got;
+	const int prio = get_process_priority(PID_P1);
+	int ret;
+
+	printf("Testing call and reply\n");
+	got = call(PID_P1, msg);
+	TEST_EXPECT(NULL, got);
+	int server = create_process(&test_echo_server, prio, USR_SZ_STACK);
+	TEST_ASSERT(server > MAX_PID);
+	ret = reply(server, msg);
+	TEST_EXPECT(RTX_ERR, ret);
+
+	// Let it block in receive first, so the call switches straight to it
+	ret = sleep(10);
+	TEST_EXPECT(RTX_OK, ret);
+	msg->mtype = 41;
+	got = call(server, msg);
+	TEST_EXPECT(msg, got);
+	TEST_EXPECT(42, msg->mtype);
+	while (server > MAX_PID && get_process_priority(server) != RTX_ERR) {
+		release_processor();
+	}
+	TEST_EXPECT(RTX_OK, echo_replied);
+
+	// Its exit frees the message it took, and ends our call
+	server = create_process(&test_silent_server, prio, USR_SZ_STACK);
+	TEST_ASSERT(server > MAX_PID);
+	got = call(server, msg);
+	TEST_EXPECT(NULL, got);
+	printf("call and reply done\n");
+}
+
+static volatile int reader_mtype = -1;
+static volatile int reader_released = RTX_ERR;
+
+static void test_multicast_reader(void)
+{
+	MSG_BUF *msg = receive_message(NULL);
+	reader_mtype = msg->mtype;
+	reader_released = release_memory_block(msg);
+}
+
+static void test_multicast(void)
+{
+	MSG_BUF *msg = request_memory_block();
+	MSG_BUF *got;
+	int ret;
+
+	printf("Testing multicast_message\n");
+	const int reader = create_process(&test_multicast_reader, get_process_priority(PID_P1), USR_SZ_STACK);
+	TEST_ASSERT(reader > MAX_PID);
+	ret = multicast_message(0, msg);
+	TEST_EXPECT(RTX_ERR, ret);
+	msg->mtype = 7;
+	ret = multicast_message(PID_BIT(PID_P1) | PID_BIT(reader), msg);
+	TEST_EXPECT(RTX_OK, ret);
+
+	// Shared, so it can't be taken back
+	ret = delayed_send(PID_P1, msg, 10);
+	TEST_EXPECT(RTX_ERR, ret);
+	got = receive_message_timeout(NULL, 100);
+	TEST_EXPECT(msg, got);
+
+	// The reader's release leaves it to us, and ours frees it
+	ret = sleep(10);
+	TEST_EXPECT(RTX_OK, ret);
+	while (reader > MAX_PID && get_process_priority(reader) != RTX_ERR) {
+		release_processor();
+	}
+	TEST_EXPECT(7, reader_mtype);
+	TEST_EXPECT(RTX_OK, reader_released);
+	ret = release_memory_block(msg);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(msg);
+	TEST_EXPECT(RTX_ERR, ret);
+	printf("multicast_message done\n");
+}
+
+// Only a block's holders can release it
+static void test_release_not_held(void)
+{
+	MSG_BUF *msg = request_memory_block();
+	int ret;
+
+	printf("Testing release_memory_block of a block we sent\n");
+	const int server = create_process(&test_silent_server, get_process_priority(PID_P1), USR_SZ_STACK);
+	TEST_ASSERT(server > MAX_PID);
+	msg->mtype = DEFAULT;
+	ret = send_message(server, msg);
+	TEST_EXPECT(RTX_OK, ret);
+	// It's the server's now, waiting in its mailbox
+	ret = release_memory_block(msg);
+	TEST_EXPECT(RTX_ERR, ret);
+
+	// The server's exit frees it
+	while (server > MAX_PID && get_process_priority(server) != RTX_ERR) {
+		release_processor();
+	}
+
+	// Nor can a block we hold be released while it's on its way to us
+	msg = request_memory_block();
+	msg->mtype = DEFAULT;
+	ret = send_message(PID_P1, msg);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(msg);
+	TEST_EXPECT(RTX_ERR, ret);
+	MSG_BUF *got = receive_message(NULL);
+	TEST_EXPECT(msg, got);
+	ret = delayed_send(PID_P1, msg, 10);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(msg);
+	TEST_EXPECT(RTX_ERR, ret);
+	got = receive_message(NULL);
+	TEST_EXPECT(msg, got);
+
+	// A multicast to us is queued through a mail link
+	const int other = create_process(&test_silent_server, get_process_priority(PID_P1), USR_SZ_STACK);
+	TEST_ASSERT(other > MAX_PID);
+	ret = multicast_message(PID_BIT(PID_P1) | PID_BIT(other), msg);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(msg);
+	TEST_EXPECT(RTX_ERR, ret);
+	got = receive_message_timeout(NULL, 100);
+	TEST_EXPECT(msg, got);
+	while (other > MAX_PID && get_process_priority(other) != RTX_ERR) {
+		release_processor();
+	}
+	ret = release_memory_block(msg);
+	TEST_EXPECT(RTX_OK, ret);
+	printf("release_memory_block of a block we sent done\n");
+}
+
+// Each size gets a block at least that large, from the smallest pool that has one
+static void test_memory_pools(void)
+{
+	MSG_BUF *got;
+	int ret;
+
+	printf("Testing request_memory_block_sized\n");
+	got = request_memory_block_sized(0);
+	TEST_EXPECT(NULL, got);
+	got = request_memory_block_sized(MEM_BLOCK_SIZE_LARGE + 1);
+	TEST_EXPECT(NULL, got);
+
+	MSG_BUF *small = request_memory_block_sized(1);
+	MSG_BUF *medium = request_memory_block_sized(MEM_BLOCK_SIZE_SMALL + 1);
+	MSG_BUF *large = request_memory_block_sized(MEM_BLOCK_SIZE_LARGE);
+	TEST_ASSERT(small != NULL && medium != NULL && large != NULL);
+	if (small == NULL || medium == NULL || large == NULL) {
+		return;
+	}
+	memset(small, 's', MEM_BLOCK_SIZE_SMALL);
+	memset(medium, 'm', MEM_BLOCK_SIZE);
+	memset(large, 'l', MEM_BLOCK_SIZE_LARGE);
+	// None of them overlap
+	TEST_EXPECT('s', small->mtext[MTEXT_MAXLEN_OF(MEM_BLOCK_SIZE_SMALL)]);
+	TEST_EXPECT('m', medium->mtext[MTEXT_MAXLEN]);
+	TEST_EXPECT('l', large->mtext[MTEXT_MAXLEN_OF(MEM_BLOCK_SIZE_LARGE)]);
+
+	// A block of any size is a message
+	large->mtype = DEFAULT;
+	ret = send_message(PID_P1, large);
+	TEST_EXPECT(RTX_OK, ret);
+	got = receive_message(NULL);
+	TEST_EXPECT(large, got);
+	ret = release_memory_block(small);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(medium);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(large);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = release_memory_block(large);
+	TEST_EXPECT(RTX_ERR, ret);
+	printf("request_memory_block_sized done\n");
+}
+
+// A mailbox holds every block in the heap, in the order they were sent
+static void test_mailbox_order(void)
+{
+	MSG_BUF *blk;
+	int sent = 0;
+	int ret;
+
+	// A block is only in one mailbox at a time
+	blk = request_memory_block();
+	blk->mtype = DEFAULT;
+	ret = send_message(PID_P1, blk);
+	TEST_EXPECT(RTX_OK, ret);
+	ret = send_message(PID_P1, blk);
+	TEST_EXPECT(RTX_ERR, ret);
+	MSG_BUF *const got = non_blocking_receive_message(NULL);
+	TEST_EXPECT(blk, got);
+	release_memory_block(blk);
+
+	ret = RTX_OK;
+	while (ret == RTX_OK && (blk = request_memory_block_timeout(0)) != NULL) {
+		blk->mtype = DEFAULT;
+		*(int *)blk->mtext = sent++;
+		ret = send_message(PID_P1, blk);
+	}
+	TEST_EXPECT(RTX_OK, ret);
+	if (ret != RTX_OK) {
+		release_memory_block(blk);
+		--sent;
+	}
+	bool in_order = true;
+	for (int i = 0; i < sent; ++i) {
+		int sender;
+		blk = non_blocking_receive_message(&sender);
+		if (blk == NULL || sender != PID_P1 || *(int *)blk->mtext != i) {
+			in_order = false;
+		}
+		if (blk != NULL) {
+			release_memory_block(blk);
+		}
+	}
+	TEST_ASSERT(in_order);
+	blk = non_blocking_receive_message(NULL);
+	TEST_EXPECT(NULL, blk);
+	printf("%d messages in one mailbox done\n", sent);
+}
+
+// Touch n bytes of the stack
+static void __attribute__((noinline)) test_use_stack(int n)
+{
+	volatile char buf[128];
+	assert(n <= sizeof(buf));
+	for (int i = 0; i < n; ++i) {
+		buf[i] = i;
+	}
+}
+
+// Stack usage only grows, and it counts what a call touched
+static void test_stack_usage(void)
+{
+	int ret;
+	ret = get_stack_usage(-1);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = get_stack_usage(PID_TIMER_IPROC);
+	TEST_EXPECT(RTX_ERR, ret);
+	ret = get_stack_usage(PID_NULL);
+	TEST_ASSERT(ret > 0);
+	const int before = get_stack_usage(PID_P1);
+	TEST_ASSERT(before > 0 && before <= USR_SZ_STACK);
+
+	// Read both before the next TEST_ASSERT, which uses more of the stack
+	test_use_stack(128);
+	const int after = get_stack_usage(PID_P1);
+	test_use_stack(8);
+	const int again = get_stack_usage(PID_P1);
+	TEST_ASSERT(after >= before && after >= 128 && after <= USR_SZ_STACK);
+	TEST_EXPECT(after, again);
+	printf("get_stack_usage done, %d bytes\n", after);
+}
+
+#define MIN_MEM_BLOCKS 5
+
+/**
+ * @brief: a process that tests the RTX API
+ */
+void proc1(void)
+{
+	test_printf("START\n");
+	test_printf("total %d tests\n", NUM_TESTS);
+
+#ifdef HAS_TIMESLICING
+	test_transition(test_state, "Memory blocking");
+	test_set_process_priority(PID_P1, LOW);
+	// Due to preemption, we can't tell whether we're blocked.
+	// Try to allocate a few blocks.
+	while (test_state == "Memory blocking") {
+		test_mem_request();
+	}
+
+	// We should have been unblocked
+	test_transition("Memory unblocked", "Get prio");
+#else
+	// int test_release_processor();
+	// This primitive transfers the control to the RTX (the calling process voluntarily releases
+	// the processor). The invoking process remains ready to execute and is put at the end of the
+	// ready queue of the same priority. Another process may possibly be selected for execution.
+	test_transition(test_state, "FIFO scheduling");
+	assert(proc2_work_remaining == 3);
+	for (int i = 2; i >= 0; --i) {
+		TEST_EXPECT(0, test_release_processor());
+		TEST_EXPECT(i, proc2_work_remaining);
+		TEST_EXPECT(i, proc3_work_remaining);
+	}
+
+	test_transition("FIFO scheduling", "Equal prio mem blocking");
+	while (test_state == "Equal prio mem blocking") {
+		test_mem_request();
+	}
+
+	// We should have been unblocked
+	test_transition("Equal prio mem unblocked", "Get prio");
+#endif
+	TEST_EXPECT(LOWEST, test_get_process_priority(PID_P1));
+	TEST_EXPECT(LOWEST, test_get_process_priority(PID_P2));
+	TEST_EXPECT(RTX_ERR, test_get_process_priority(-1));
+	TEST_EXPECT(RTX_ERR, test_get_process_priority(MAX_PID + 1));
+	TEST_EXPECT(4, test_get_process_priority(PID_NULL));
+
+	test_transition("Get prio", "Set null prio");
+	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_NULL, -1));
+	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_NULL, 0));
+	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_NULL, 3));
+	TEST_EXPECT(0, test_set_process_priority(PID_NULL, 4));
+
+	test_transition("Set null prio", "Set user prio (no-op)");
+	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_P1, -1));
+	TEST_EXPECT(RTX_ERR, test_set_process_priority(PID_P1, 4));
+	TEST_EXPECT(0, test_set_process_priority(PID_P1, test_get_process_priority(PID_P1)));
+	TEST_EXPECT(0, test_set_process_priority(PID_P2, test_get_process_priority(PID_P2)));
+
+	test_transition("Set user prio (no-op)", "Set user prio (higher)");
+	TEST_EXPECT(0, test_set_process_priority(PID_P2, MEDIUM));
+
+#ifdef HAS_TIMESLICING
+	test_transition("Set user prio (inversion)", "Preempt (inversion)");
+#else
+	test_transition("Set user prio (inversion 2)", "Preempt (inversion)");
+#endif
+	TEST_EXPECT(0, test_set_process_priority(PID_P2, HIGH));
+	test_mem_release();
+
+	test_transition("Set user prio (lower)", "Release processor (max prio)");
+	// We're prio LOW, so we should still run.
+	TEST_EXPECT(0, test_release_processor());
+
+	test_transition("Release processor (max prio)", "Resource contention (1 blocked)");
+	test_mem_request();
+
+	test_transition("Resource contention resolved", "Count blocks");
+	int blocks = 0;
+	while (test_mem_front != NULL) {
+		test_mem_release();
+		++blocks;
+	}
+	TEST_ASSERT(blocks >= 5);
+
+	test_transition("Count blocks", "Send self msg");
+	{
+		char msg_buf[128];
+		struct msgbuf *msg = (struct msgbuf *)msg_buf;
+		msg->mtype = DEFAULT;
+		strcpy(msg->mtext, "Hi");
+		TEST_EXPECT(0, !send_message(-1, msg));
+		TEST_EXPECT(0, delayed_send(PID_P1, msg, 0));
+
+		{
+			int from = -1;
+			struct msgbuf *m1 = receive_message(&from);
+			TEST_EXPECT(PID_P1, from);
+			TEST_EXPECT(msg, m1);
+			TEST_ASSERT(!strcmp("Hi", m1->mtext));
+		}
+
+		{
+			TEST_EXPECT(0, send_message(PID_P1, msg));
+			struct msgbuf *m2 = receive_message(NULL);
+			TEST_ASSERT(!strcmp("Hi", m2->mtext));
+		}
+	}
+
+	test_transition("Send self msg", "Send other msg");
+	test_set_process_priority(PID_P2, HIGH);
+	test_set_process_priority(PID_P3, HIGH);
+	test_transition("Send other msg (2 and 3 blocked)", "Recv other msg (2 and 3 blocked)");
+	for (int i = 0; i < 2; ++i) {
+		const static int pids[2] = {PID_P2, PID_P3};
+		struct msgbuf *msg = (struct msgbuf *)request_memory_block();
+		msg->mtype = 42;
+		strcpy(msg->mtext, "42");
+		TEST_EXPECT(0, send_message(pids[i], msg));
+	}
+
+	test_release_processor();
+	test_transition("Send delayed msg", "Recv delayed msg");
+	for (int i = 0; i < 3; ++i) {
+		int from = -1;
+		struct msgbuf *msg = receive_message(&from);
+		TEST_EXPECT(PID_P2, from);
+		TEST_EXPECT(10 + i, msg->mtype);
+		char buf[MTEXT_MAXLEN + 1];
+		snprintf(buf, MTEXT_MAXLEN, "%d", i);
+		TEST_ASSERT(!strncmp(buf, msg->mtext, MTEXT_MAXLEN));
+	}
+
+	test_transition("Recv delayed msg", "Tests done");
+
+	TEST_EXPECT(0, changed_bytes);
+	TEST_ASSERT(finished_proc >= 2);
+	while (finished_proc < 2) {
+		test_release_processor();
+	}
+
+	// These count towards NUM_TESTS too, so they run before the report
+	test_time_primitives(PID_P1);
+	test_time_timer_wheel();
+	test_cancel_delayed_send();
+	test_periodic_send();
+	test_sleep();
+	test_timeouts();
+	test_receive_match();
+	test_receive_batch();
+	test_call_reply();
+	test_multicast();
+	test_memory_pools();
+	test_release_not_held();
+	test_stack_usage();
+	test_mailbox_order();
+	test_create_exit_process();
+
+	test_printf("%d/%d tests OK\n", tests_ran - tests_failed, tests_ran);
+	test_printf("%d/%d tests FAIL\n", tests_failed, tests_ran);
+	// This invalidates tests_ran, but since all processes have reached
+	//   infinite_loop(), everything is okay.
+	assert(NUM_TESTS == tests_ran);
+	test_printf("END\n");
+	finished = 1;
+	
+	test_time_ready_queue();
+	infinite_loop();
+}
+
+static void test_receive_42_from_proc1(void)
+{
+	int from = -1;
+	struct msgbuf *msg = receive_message(&from);
+	TEST_EXPECT(PID_P1, from);
+	TEST_EXPECT(42, msg->mtype);
+	TEST_ASSERT(!strcmp("42", msg->mtext));
+	release_memory_block(msg);
+}
+
+/**
+ * @brief: a helper process to proc1
+ */
+void proc2(void)
+{
+	printf("Started %s\n", __FUNCTION__);
+#ifdef HAS_TIMESLICING
+	test_transition("Memory blocking", "Memory blocked");
+	test_set_process_priority(PID_P1, LOWEST);
+
+	// Let's free enough memory
+	test_mem_release();
+	test_mem_release();
+	test_transition("Memory blocked", "Memory unblocked");
+
+	test_transition("Set user prio (higher)", "Set user prio (inversion)");
+	for (int i = 0; i < 30 && test_state == "Set user prio (inversion)"; ++i) {
+		test_mem_request();
+	}
+#else
+	while (proc2_work_remaining > 0) {
+		TEST_EXPECT(proc3_work_remaining, proc2_work_remaining);
+		--proc2_work_remaining;
+		TEST_EXPECT(0, test_release_processor());
+	}
+	test_transition("Equal prio mem blocking", "Equal prio mem unblocking");
+
+	// Let's free enough memory
+	test_mem_release();
+	test_mem_release();
+
+	test_transition("Equal prio mem unblocking", "Equal prio mem unblocking 2");
+	// Should schedule proc3 since proc1 was preempted recently
+	TEST_EXPECT(0, test_release_processor());
+
+	test_transition("Set user prio (higher)", "Set user prio (inversion)");
+	for (int i = 0; i < 3 && test_state == "Set user prio (inversion)"; ++i) {
+		test_mem_request();
+	}
+#endif
+
+	test_transition("Preempt (inversion)", "Set prio preempt (failed)");
+	TEST_EXPECT(0, test_set_process_priority(PID_P1, LOW));
+	TEST_EXPECT(0, test_set_process_priority(PID_P2, MEDIUM));
+
+	test_transition("Set prio preempt (failed)", "Set user prio (lower, tied)");
+	TEST_EXPECT(0, test_set_process_priority(PID_P2, LOW));
+
+	test_transition("Set user prio (lower, tied)", "Set user prio (lower)");
+	// Move ourselves after proc3 in the ready queue
+	TEST_EXPECT(0, test_set_process_priority(PID_P2, LOWEST));
+
+	test_transition("Resource contention (1 and 3 blocked)", "Resource contention (3 and 1 blocked)");
+	TEST_EXPECT(0, test_set_process_priority(PID_P3, HIGH));
+	TEST_EXPECT(0, test_set_process_priority(PID_P1, LOWEST));
+	TEST_EXPECT(0, test_set_process_priority(PID_P2, LOWEST));
+	test_mem_release();
+
+	test_transition("Send other msg", "Send other msg (2 blocked)");
+	TEST_EXPECT(HIGH, test_get_process_priority(PID_P2));
+	test_receive_42_from_proc1();
+	test_transition("Recv other msg (2 and 3 blocked)", "Recv other msg (3 blocked)");
+	TEST_EXPECT(0, test_set_process_priority(PID_P2, LOWEST));
+	release_processor(); // Go to proc2
+
+	test_transition("Recv other msg (done)", "Send delayed msg");
+	for (int i = 2; i >= 0; --i) {
+		struct msgbuf *msg = (struct msgbuf *)request_memory_block();
+		msg->mtype = 10 + i;
+		sprintf(msg->mtext, "%d", i);
+		TEST_EXPECT(0, delayed_send(PID_P1, msg, i * 100));
+	}
+
+	++finished_proc;
+
+	infinite_loop();
+}
+
+/**
+ * A second helper process.
+ */
+void proc3(void)
+{
+	printf("Started %s\n", __FUNCTION__);
+#ifndef HAS_TIMESLICING
+	while (proc3_work_remaining > 0) {
+		--proc3_work_remaining;
+		TEST_EXPECT(proc2_work_remaining, proc3_work_remaining);
+		TEST_EXPECT(0, test_release_processor());
+	}
+
+	// Since proc1 was preempted, it's at the back of the ready queue
+	// Let's run it.
+	test_transition("Equal prio mem unblocking 2", "Equal prio mem unblocked");
+	test_release_processor();
+
+	test_transition("Set user prio (inversion)", "Set user prio (inversion 2)");
+	test_release_processor();
+#endif
+
+	test_transition("Resource contention (1 blocked)", "Resource contention (1 and 3 blocked)");
+	test_mem_request();
+
+	test_transition("Resource contention (3 and 1 blocked)", "Resource contention (1 blocked again)");
+	test_mem_release();
+
+	test_transition("Resource contention (1 blocked again)", "Resource contention resolved");
+	TEST_EXPECT(0, test_set_process_priority(PID_P3, LOWEST));
+	release_processor(); // Go back to proc1
+
+	test_transition("Send other msg (2 blocked)", "Send other msg (2 and 3 blocked)");
+	TEST_EXPECT(HIGH, test_get_process_priority(PID_P2));
+	test_receive_42_from_proc1();
+	test_transition("Recv other msg (3 blocked)", "Recv other msg (done)");
+	TEST_EXPECT(0, test_set_process_priority(PID_P3, LOWEST));
+
+	++finished_proc;
+	TEST_EXPECT(0, test_release_processor());
+
+	infinite_loop();
+}
+
+// Process to show blocked on receive state hotkey
+void proc4(void)
+{
+	for (;;) {
+		receive_message(NULL);
+	}
+}
+
+// Process to show ready state hotkey
+void proc5(void)
+{
+	infinite_loop();
+}
+
+// Process to show blocked on memory hotkey
+void proc6(void)
+{
+	for (;;) {
+		infinite_loop();
+	}
+}
+
+/********************* Stress Test Procs ***********************/
+void proc_A(void)
+{
+	// Process A:
+	// p <- request_memory_block
+  // register with Command Decoder as handler of %Z commands
+	struct msgbuf *p_msg_env = (struct msgbuf *)request_memory_block_sized(MEM_BLOCK_SIZE_SMALL);
+	p_msg_env->mtype = KCD_REG;
+	strcpy(p_msg_env->mtext, "%Z");
+	send_message(PID_KCD, p_msg_env);
+
+	for (;;) {
+		// p <- receive a message
+		// if the message(p) contains the %Z command then
+		//   release_memory_block(p)
+		//   exit the loop
+		// else
+		//   release_memory_block(p)
+		// endif
+		p_msg_env = receive_message(NULL);
+		if(strstr(p_msg_env->mtext, "%Z") != NULL) {
+			release_memory_block(p_msg_env);
+			break;
+		} else {
+			release_memory_block(p_msg_env);
+		}
+	}
+	printf("Got command %Z\n");
+	// Second loop:
+	// num = 0
+	int num = 0;
+	for (;;) {
+		// p <- request memory block to be used as a message envelope
+		// set message_type field of p to count_report
+		// set msg_data[0] field of p to num
+		// send the message(p) to process B
+		// num = num + 1
+		// release_processor()
+		p_msg_env = (struct msgbuf *)request_memory_block_sized(MEM_BLOCK_SIZE_SMALL);
+		p_msg_env->mtype = COUNT_REPORT;
+		_sprintf(p_msg_env->mtext, "%d", num);
+		printf("proc_A sending message #%d\n", num);
+		send_message(PID_B, p_msg_env);
+		printf("proc_A sent message #%d\n", num);
+		num++;
+		release_processor();
+	}
+	// note that Process A does not de-allocate
+	// any received envelopes in the second loop
+}
+
+void proc_B(void)
+{
+	// loop forever
+	// receive a message
+	// send the message to process C
+	// endloop
+	for (;;) {
+		struct msgbuf *msg = receive_message(NULL);
+		printf("proc_B sending message to proc_C: %s\n", msg->mtext);
+		send_message(PID_C, msg);
+	}
+}
+
+void proc_C(void) {
+	for(;;) {
+		// p <- receive a message
+		struct msgbuf* msg = receive_message(NULL);
+
+		// if msg_type of p == count_report then
+		//   if msg_data[0] of p is evenly divisible by 20 then
+		//     send "Process C" to CRT display using msg envelope p
+		//     hibernate for 10 sec
+		//   endif
+		// endif
+		if (msg->mtype == COUNT_REPORT) {
+			int count = atoi(msg->mtext);
+
+			if (count % 20 == 0) {
+				msg->mtype = CRT_DISPLAY;
+				strcpy(msg->mtext, "Process C\n");
+				send_message(PID_CRT, msg);
+
+				// Takes no memory block, and whatever arrives meanwhile
+				// waits in our mailbox for the receive above
+				sleep(10000);
+				continue;
+			}
+		}
+		
+		release_memory_block(msg);
+		release_processor();
+	}
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Decode kernel trace dumps (see rtx/src/k_trace.h) into a timeline.
+
+Press '$' on the RTX console to dump the trace to UART1, then:
+    python3 trace_decode.py uart1.log
+or pipe the UART1 output in on stdin. Every dump in the log is decoded.
+"""
+
+import sys
+
+# PROC_STATE_E in common.h
+STATES = ["NEW", "RDY", "RUN", "BLOCKED_ON_RESOURCE", "BLOCKED_ON_RECEIVE", "BLOCKED_ON_TIMER", "BLOCKED_ON_REPLY", "UNUSED"]
+
+# pids in common.h
+PIDS = {
+    0: "NULL", 1: "P1", 2: "P2", 3: "P3", 4: "P4", 5: "P5", 6: "P6",
+    7: "A", 8: "B", 9: "C", 10: "SET_PRIO", 11: "CLOCK",
+    12: "KCD", 13: "CRT", 14: "TIMER_IPROC", 15: "UART_IPROC", 16: "TOP",
+}
+
+
+def pid_name(pid):
+    if pid == 0xFF or pid == 0xFFFF:
+        return "none"
+    return PIDS.get(pid, str(pid))
+
+
+def state_name(state):
+    return STATES[state] if state < len(STATES) else str(state)
+
+
+# TRACE_* in k_trace.h
+EVENTS = {
+    1: lambda pid, arg: "switch %s -> %s" % (pid_name(arg), pid_name(pid)),
+    2: lambda pid, arg: "%s is %s" % (pid_name(pid), state_name(arg)),
+    3: lambda pid, arg: "%s sends to %s" % (pid_name(pid), pid_name(arg)),
+    4: lambda pid, arg: "%s receives from %s" % (pid_name(pid), pid_name(arg)),
+    5: lambda pid, arg: "%s allocates block %d" % (pid_name(pid), arg),
+    6: lambda pid, arg: "%s frees block %d" % (pid_name(pid), arg),
+    7: lambda pid, arg: "delayed message from %s to %s expires" % (pid_name(arg), pid_name(pid)),
+}
+
+
+def parse_dumps(lines):
+    """Yield (recorded, clock_hz, [(time, event, pid, arg)]) for each dump."""
+    dump = None
+    for line in lines:
+        words = line.split()
+        if len(words) == 3 and words[0] == "TRACE":
+            dump = (int(words[1], 16), int(words[2], 16), [])
+        elif dump is not None and words == ["END"]:
+            yield dump
+            dump = None
+        elif dump is not None and len(words) == 4:
+            try:
+                dump[2].append(tuple(int(word, 16) for word in words))
+            except ValueError:
+                dump = None  # garbled line, skip this dump
+
+
+def print_timeline(recorded, clock_hz, events):
+    lost = recorded - len(events)
+    print("%d events, %d older ones overwritten" % (len(events), lost))
+    print("%12s %10s  %s" % ("time (us)", "delta (us)", "event"))
+    prev = events[0][0] if events else 0
+    elapsed = 0
+    for time, event, pid, arg in events:
+        # TIM1 is a 32-bit counter, so it wraps every ~43 s at 100 MHz
+        delta = (time - prev) & 0xFFFFFFFF
+        elapsed += delta
+        prev = time
+        describe = EVENTS.get(event, lambda pid, arg: "event %d pid %d arg %d" % (event, pid, arg))
+        print("%12.1f %10.1f  %s" % (elapsed * 1e6 / clock_hz, delta * 1e6 / clock_hz, describe(pid, arg)))
+
+
+def main():
+    lines = open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin
+    found = False
+    for dump in parse_dumps(lines):
+        if found:
+            print()
+        print_timeline(*dump)
+        found = True
+    if not found:
+        print("No trace dump found", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())